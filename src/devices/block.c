@@ -3,7 +3,21 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* pseudOS: Ticks a queued read or write may wait before it is
+   dispatched ahead of the elevator order. */
+#define READ_DEADLINE (TIMER_FREQ / 10)
+#define WRITE_DEADLINE (TIMER_FREQ)
+
+/* pseudOS: Most sectors that adjacent requests are merged into,
+   limited by the page the dispatcher gathers them in. */
+#define MERGE_MAX (PGSIZE / BLOCK_SECTOR_SIZE)
 
 /* A block device. */
 struct block
@@ -17,8 +31,25 @@ struct block
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct blkstat stats;               /* pseudOS: I/O statistics. */
+    unsigned long long cache_hit_cnt;   /* pseudOS: Buffer cache hits. */
+    unsigned long long cache_miss_cnt;  /* pseudOS: Buffer cache misses. */
+    unsigned long long ra_hit_cnt;      /* pseudOS: Read-ahead sectors used. */
+    unsigned long long ra_waste_cnt;    /* pseudOS: Read-ahead sectors evicted
+                                           before use. */
+
+    /* pseudOS: Requests to a partition go to the queue of the
+       disk it is on, at sector offset PARENT_START. */
+    struct block *parent;               /* Containing device, or null. */
+    block_sector_t parent_start;        /* First sector in PARENT. */
+
+    /* pseudOS: Request queue, sorted by sector. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct condition queue_ready;       /* Signaled when QUEUE grows. */
+    struct list queue;                  /* Pending block_requests. */
+    block_sector_t head;                /* Sector after the last dispatch. */
+    size_t busy_cnt;                    /* Requests being transferred. */
+    bool dispatcher_started;            /* Dispatcher thread created? */
   };
 
 /* List of all block devices. */
@@ -28,6 +59,15 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void transfer (struct block *, bool write, block_sector_t,
+                      void *buffer, size_t cnt);
+static struct block_request *pick_request (struct block *);
+static thread_func dispatcher NO_RETURN;
+static list_less_func request_less;
+static void complete_request (struct block_request *);
+static void histogram_add (uint64_t histogram[BLKSTAT_BUCKETS],
+                           uint64_t cycles);
+static void record_depth (struct blkstat *, size_t depth);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -120,9 +160,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multiple (block, sector, buffer, 1);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +171,298 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multiple (block, sector, buffer, 1);
+}
+
+/* pseudOS: Reads CNT consecutive sectors starting at SECTOR from
+   BLOCK into BUFFER, which must have room for CNT *
+   BLOCK_SECTOR_SIZE bytes.  Drivers that support it transfer all
+   of them with a single command.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     void *buffer, size_t cnt)
+{
+  struct block_request r;
+
+  if (cnt == 0)
+    return;
+  block_request_init (&r, false, sector, buffer, cnt);
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* pseudOS: Writes CNT consecutive sectors starting at SECTOR to
+   BLOCK from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE
+   bytes.  Returns after the block device has acknowledged
+   receiving the data.  Drivers that support it transfer all of
+   them with a single command.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      const void *buffer, size_t cnt)
+{
+  struct block_request r;
+
+  if (cnt == 0)
+    return;
+  block_request_init (&r, true, sector, (void *) buffer, cnt);
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* pseudOS: Initializes R to read or, if WRITE is true, write CNT
+   sectors starting at SECTOR from or to BUFFER.  The caller may
+   set R's DONE and AUX members before submitting it. */
+void
+block_request_init (struct block_request *r, bool write,
+                    block_sector_t sector, void *buffer, size_t cnt)
+{
+  ASSERT (cnt > 0);
+
+  r->sector = sector;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->write = write;
+  r->done = NULL;
+  r->aux = NULL;
+  sema_init (&r->complete, 0);
+}
+
+/* pseudOS: Queues request R on BLOCK and returns without waiting
+   for it.  Requests to a partition are queued on its disk, so R's
+   SECTOR member is relative to that disk afterward. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  struct blkstat *stats = &block->stats;
+  struct block *b;
+
+  check_sector (block, r->sector);
+  check_sector (block, r->sector + r->cnt - 1);
+  ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+
+  /* A request to a partition is also a request to its disk. */
+  for (b = block; b != NULL; b = b->parent)
+    if (r->write)
+      {
+        b->stats.write_cnt += r->cnt;
+        b->stats.write_req_cnt++;
+      }
+    else
+      {
+        b->stats.read_cnt += r->cnt;
+        b->stats.read_req_cnt++;
+      }
+  r->block = block;
+  r->start = timer_cycles ();
+
+  for (; block->parent != NULL; block = block->parent)
+    r->sector += block->parent_start;
+  r->deadline = timer_ticks () + (r->write ? WRITE_DEADLINE : READ_DEADLINE);
+
+  lock_acquire (&block->queue_lock);
+  if (!block->dispatcher_started)
+    {
+      char name[sizeof block->name + 4];
+      snprintf (name, sizeof name, "blk-%s", block->name);
+      block->dispatcher_started
+        = thread_create (name, PRI_DEFAULT, dispatcher, block) != TID_ERROR;
+    }
+  if (block->dispatcher_started)
+    {
+      list_insert_ordered (&block->queue, &r->elem, request_less, NULL);
+      record_depth (stats, list_size (&block->queue) + block->busy_cnt);
+      cond_signal (&block->queue_ready, &block->queue_lock);
+      lock_release (&block->queue_lock);
+    }
+  else
+    {
+      /* No dispatcher: do the transfer right away. */
+      lock_release (&block->queue_lock);
+      record_depth (stats, 1);
+      transfer (block, r->write, r->sector, r->buffer, r->cnt);
+      complete_request (r);
+    }
+}
+
+/* pseudOS: Waits for submitted request R to complete. */
+void
+block_wait (struct block_request *r)
+{
+  sema_down (&r->complete);
+}
+
+/* pseudOS: Has the driver of BLOCK transfer CNT sectors starting
+   at SECTOR.  Uses a single driver call where the driver allows
+   it. */
+static void
+transfer (struct block *block, bool write, block_sector_t sector,
+          void *buffer, size_t cnt)
+{
+  uint8_t *p = buffer;
+  size_t i;
+
+  if (write)
+    {
+      if (block->ops->write_multiple != NULL)
+        block->ops->write_multiple (block->aux, sector, buffer, cnt);
+      else
+        for (i = 0; i < cnt; i++)
+          block->ops->write (block->aux, sector + i,
+                             p + i * BLOCK_SECTOR_SIZE);
+    }
+  else
+    {
+      if (block->ops->read_multiple != NULL)
+        block->ops->read_multiple (block->aux, sector, buffer, cnt);
+      else
+        for (i = 0; i < cnt; i++)
+          block->ops->read (block->aux, sector + i,
+                            p + i * BLOCK_SECTOR_SIZE);
+    }
+}
+
+/* pseudOS: Chooses the next request to dispatch from BLOCK's
+   queue, which must not be empty.  This is the request whose
+   deadline expired longest ago, if any.  Otherwise, C-LOOK: the
+   lowest sector at or after the head, wrapping around to the
+   lowest sector overall. */
+static struct block_request *
+pick_request (struct block *block)
+{
+  struct block_request *expired = NULL, *next = NULL;
+  int64_t now = timer_ticks ();
+  struct list_elem *e;
+
+  ASSERT (!list_empty (&block->queue));
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->deadline <= now
+          && (expired == NULL || r->deadline < expired->deadline))
+        expired = r;
+      if (next == NULL && r->sector >= block->head)
+        next = r;
+    }
+
+  if (expired != NULL)
+    return expired;
+  if (next != NULL)
+    return next;
+  return list_entry (list_front (&block->queue), struct block_request, elem);
+}
+
+/* pseudOS: Thread function for the dispatcher of block device
+   BLOCK_.  Takes requests off the queue in elevator order,
+   together with the requests that directly follow them on disk
+   in the same direction, and transfers each such batch at once,
+   gathering the data in a page if there is more than one
+   request. */
+static void
+dispatcher (void *block_)
+{
+  struct block *block = block_;
+  uint8_t *run_data = palloc_get_page (PAL_ASSERT);
+
+  for (;;)
+    {
+      struct list batch;
+      struct block_request *first, *r;
+      struct list_elem *e, *next;
+      block_sector_t end;
+      size_t cnt;
+
+      lock_acquire (&block->queue_lock);
+      while (list_empty (&block->queue))
+        cond_wait (&block->queue_ready, &block->queue_lock);
+
+      list_init (&batch);
+      first = pick_request (block);
+      end = first->sector + first->cnt;
+      cnt = first->cnt;
+      e = list_remove (&first->elem);
+      list_push_back (&batch, &first->elem);
+      while (e != list_end (&block->queue))
+        {
+          r = list_entry (e, struct block_request, elem);
+          if (r->write != first->write || r->sector != end
+              || cnt + r->cnt > MERGE_MAX)
+            break;
+          end += r->cnt;
+          cnt += r->cnt;
+          e = list_remove (&r->elem);
+          list_push_back (&batch, &r->elem);
+        }
+      block->head = end;
+      block->busy_cnt = list_size (&batch);
+      lock_release (&block->queue_lock);
+
+      if (list_size (&batch) == 1)
+        transfer (block, first->write, first->sector, first->buffer,
+                  first->cnt);
+      else
+        {
+          uint8_t *p;
+
+          if (first->write)
+            for (e = list_begin (&batch), p = run_data;
+                 e != list_end (&batch); e = list_next (e))
+              {
+                r = list_entry (e, struct block_request, elem);
+                memcpy (p, r->buffer, r->cnt * BLOCK_SECTOR_SIZE);
+                p += r->cnt * BLOCK_SECTOR_SIZE;
+              }
+          transfer (block, first->write, first->sector, run_data, cnt);
+          if (!first->write)
+            for (e = list_begin (&batch), p = run_data;
+                 e != list_end (&batch); e = list_next (e))
+              {
+                r = list_entry (e, struct block_request, elem);
+                memcpy (r->buffer, p, r->cnt * BLOCK_SECTOR_SIZE);
+                p += r->cnt * BLOCK_SECTOR_SIZE;
+              }
+        }
+
+      lock_acquire (&block->queue_lock);
+      block->busy_cnt = 0;
+      lock_release (&block->queue_lock);
+
+      /* A request may be freed as soon as it is up'd, so advance
+         past it first. */
+      for (e = list_begin (&batch); e != list_end (&batch); e = next)
+        {
+          next = list_next (e);
+          complete_request (list_entry (e, struct block_request, elem));
+        }
+    }
+}
+
+/* pseudOS: Records the latency of transferred request R, calls
+   its completion callback, if any, and wakes up its waiters. */
+static void
+complete_request (struct block_request *r)
+{
+  struct blkstat *stats = &r->block->stats;
+
+  histogram_add (r->write ? stats->write_latency : stats->read_latency,
+                 timer_cycles () - r->start);
+  if (r->done != NULL)
+    r->done (r);
+  sema_up (&r->complete);
+}
+
+/* pseudOS: Orders block_requests by sector. */
+static bool
+request_less (const struct list_elem *a, const struct list_elem *b,
+              void *aux UNUSED)
+{
+  return (list_entry (a, struct block_request, elem)->sector
+          < list_entry (b, struct block_request, elem)->sector);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,6 +486,28 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* pseudOS: Prints the nonzero buckets of HISTOGRAM of BLOCK,
+   labeled with WHAT, on a single line. */
+static void
+print_histogram (struct block *block, const char *what,
+                 const uint64_t histogram[BLKSTAT_BUCKETS])
+{
+  int i;
+
+  for (i = 0; i < BLKSTAT_BUCKETS; i++)
+    if (histogram[i] != 0)
+      break;
+  if (i == BLKSTAT_BUCKETS)
+    return;
+
+  printf ("%s (%s): %s, log2(cycles):count",
+          block->name, block_type_name (block->type), what);
+  for (; i < BLKSTAT_BUCKETS; i++)
+    if (histogram[i] != 0)
+      printf (" %d:%llu", i, histogram[i]);
+  printf ("\n");
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
@@ -171,13 +519,113 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
+          struct blkstat stats;
+
+          block_get_stats (block, &stats);
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  stats.read_cnt, stats.write_cnt);
+          if (block->cache_hit_cnt + block->cache_miss_cnt > 0)
+            printf ("%s (%s): %llu cache hits, %llu cache misses\n",
+                    block->name, block_type_name (block->type),
+                    block->cache_hit_cnt, block->cache_miss_cnt);
+          if (block->ra_hit_cnt + block->ra_waste_cnt > 0)
+            printf ("%s (%s): %llu read-ahead hits, %llu wasted read-aheads\n",
+                    block->name, block_type_name (block->type),
+                    block->ra_hit_cnt, block->ra_waste_cnt);
+          if (stats.depth_samples > 0)
+            {
+              uint64_t avg10 = stats.depth_sum * 10 / stats.depth_samples;
+              printf ("%s (%s): %llu read requests, %llu write requests, "
+                      "queue depth %llu.%llu average, %llu max\n",
+                      block->name, block_type_name (block->type),
+                      stats.read_req_cnt, stats.write_req_cnt,
+                      avg10 / 10, avg10 % 10, stats.depth_max);
+            }
+          print_histogram (block, "read latency", stats.read_latency);
+          print_histogram (block, "write latency", stats.write_latency);
+          print_histogram (block, "device service", stats.service);
         }
     }
 }
 
+/* pseudOS: Copies BLOCK's I/O statistics into STATS.  The device
+   service histogram of a partition is that of its disk.  The copy
+   is taken with interrupts off, so STATS must be kernel memory
+   that cannot page fault. */
+void
+block_get_stats (struct block *block, struct blkstat *stats)
+{
+  struct block *disk;
+  enum intr_level old_level;
+
+  for (disk = block; disk->parent != NULL; disk = disk->parent)
+    continue;
+
+  old_level = intr_disable ();
+  *stats = block->stats;
+  memcpy (stats->service, disk->stats.service, sizeof stats->service);
+  intr_set_level (old_level);
+}
+
+/* pseudOS: Records a buffer cache access to BLOCK, which was a
+   hit if HIT is true and a miss otherwise. */
+void
+block_record_cache_access (struct block *block, bool hit)
+{
+  if (hit)
+    block->cache_hit_cnt++;
+  else
+    block->cache_miss_cnt++;
+}
+
+/* pseudOS: Records that a sector of BLOCK loaded by read-ahead
+   was used, if HIT is true, or evicted unused otherwise. */
+void
+block_record_read_ahead (struct block *block, bool hit)
+{
+  if (hit)
+    block->ra_hit_cnt++;
+  else
+    block->ra_waste_cnt++;
+}
+
+/* pseudOS: Records that the device of BLOCK, which must be a
+   whole disk, took CYCLES to service a command or a sector of
+   one.  May be called from an interrupt handler. */
+void
+block_record_service (struct block *block, uint64_t cycles)
+{
+  ASSERT (block->parent == NULL);
+
+  histogram_add (block->stats.service, cycles);
+}
+
+/* pseudOS: Counts CYCLES in the log2 bucket of HISTOGRAM it
+   falls in. */
+static void
+histogram_add (uint64_t histogram[BLKSTAT_BUCKETS], uint64_t cycles)
+{
+  int i = 0;
+
+  while (cycles > 1 && i < BLKSTAT_BUCKETS - 1)
+    {
+      cycles >>= 1;
+      i++;
+    }
+  histogram[i]++;
+}
+
+/* pseudOS: Adds DEPTH as a queue depth sample to STATS. */
+static void
+record_depth (struct blkstat *stats, size_t depth)
+{
+  stats->depth_samples++;
+  stats->depth_sum += depth;
+  if (depth > stats->depth_max)
+    stats->depth_max = depth;
+}
+
 /* Registers a new block device with the given NAME.  If
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
@@ -198,8 +646,19 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  memset (&block->stats, 0, sizeof block->stats);
+  block->cache_hit_cnt = 0;
+  block->cache_miss_cnt = 0;
+  block->ra_hit_cnt = 0;
+  block->ra_waste_cnt = 0;
+  block->parent = NULL;
+  block->parent_start = 0;
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_ready);
+  list_init (&block->queue);
+  block->head = 0;
+  block->busy_cnt = 0;
+  block->dispatcher_started = false;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -211,6 +670,19 @@ block_register (const char *name, enum block_type type,
   return block;
 }
 
+/* pseudOS: Declares BLOCK to be a partition of PARENT that
+   starts at sector START, so that requests to BLOCK are queued on
+   PARENT. */
+void
+block_set_parent (struct block *block, struct block *parent,
+                  block_sector_t start)
+{
+  ASSERT (start + block->size <= parent->size);
+
+  block->parent = parent;
+  block->parent_start = start;
+}
+
 /* Returns the block device corresponding to LIST_ELEM, or a null
    pointer if LIST_ELEM is the list end of all_blocks. */
 static struct block *
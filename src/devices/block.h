@@ -1,8 +1,12 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <blkstat.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,11 +57,50 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, void *,
+                          size_t cnt);
+void block_write_multiple (struct block *, block_sector_t, const void *,
+                           size_t cnt);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* pseudOS: Asynchronous requests.
+
+   A request is queued on its device and dispatched in elevator
+   order by the device's dispatcher thread, which merges it with
+   adjacent requests where it can.  When the transfer is done,
+   DONE is called, if it is non-null, from the dispatcher thread,
+   and then COMPLETE is up'd.  The submitter must keep the request
+   and its buffer alive until then. */
+struct block_request;
+typedef void block_done_func (struct block_request *);
+
+struct block_request
+  {
+    struct list_elem elem;              /* Element in a device queue. */
+    block_sector_t sector;              /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+    void *buffer;                       /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                         /* Write if true, read if false. */
+    int64_t deadline;                   /* Dispatch by this timer tick. */
+    block_done_func *done;              /* Completion callback, or null. */
+    void *aux;                          /* For use by DONE. */
+    struct semaphore complete;          /* Up'd on completion. */
+    struct block *block;                /* Device submitted to. */
+    uint64_t start;                     /* Time-stamp counter at submit. */
+  };
+
+void block_request_init (struct block_request *, bool write, block_sector_t,
+                         void *buffer, size_t cnt);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+
 /* Statistics. */
 void block_print_stats (void);
+void block_record_cache_access (struct block *, bool hit);
+void block_record_read_ahead (struct block *, bool hit);
+void block_record_service (struct block *, uint64_t cycles);
+void block_get_stats (struct block *, struct blkstat *);
 
 /* Lower-level interface to block device drivers. */
 
@@ -65,10 +108,20 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* pseudOS: Optional.  Transfer CNT consecutive sectors at
+       once.  If null, the block layer transfers one sector at a
+       time. */
+    void (*read_multiple) (void *aux, block_sector_t, void *buffer,
+                           size_t cnt);
+    void (*write_multiple) (void *aux, block_sector_t, const void *buffer,
+                            size_t cnt);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_set_parent (struct block *, struct block *parent,
+                       block_sector_t start);
 
 #endif /* devices/block.h */
@@ -3,12 +3,15 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
 #include "devices/partition.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -34,6 +37,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +53,41 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* pseudOS: READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* pseudOS: WRITE DMA. */
+
+/* pseudOS: Most sectors transferred by a single command.  The
+   Sector Count register is 8 bits wide. */
+#define MAX_SECTORS_PER_CMD 255
+
+/* pseudOS: PCI bus-master IDE (SFF-8038i) port addresses, relative
+   to the channel's bus-master base from BAR4 of the controller's
+   PCI configuration space. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* pseudOS: Bus-master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* pseudOS: Bus-master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error, write 1 to clear. */
+#define BM_STA_IRQ 0x04         /* Interrupt, write 1 to clear. */
+
+/* pseudOS: A Physical Region Descriptor.  A PRD table is a list
+   of these, the last one marked with PRD_EOT, that tells the
+   controller where in physical memory to transfer data.  A
+   region must not cross a 64 kB boundary; a size of 0 means
+   64 kB. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Byte count. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000
+#define PRD_CNT (PGSIZE / sizeof (struct prd))
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +96,8 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool dma;                   /* pseudOS: Use bus-master DMA? */
+    struct block *block;        /* pseudOS: Block device, once registered. */
   };
 
 /* An ATA channel (aka controller).
@@ -72,6 +113,14 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bm_base;           /* pseudOS: Bus-master ports, 0 if none. */
+    struct prd *prdt;           /* pseudOS: PRD table for DMA. */
+    uint8_t bm_status;          /* pseudOS: Bus-master status at the last
+                                   interrupt. */
+    const struct ata_disk *active;  /* pseudOS: Last selected device. */
+    uint64_t issue_cycles;      /* pseudOS: Time-stamp counter at the last
+                                   command or interrupt. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -80,16 +129,23 @@ struct channel
 static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
+static void ide_read_multiple (void *, block_sector_t, void *, size_t);
+static void ide_write_multiple (void *, block_sector_t, const void *,
+                                size_t);
 
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
+static uint16_t find_bus_master (void);
+static bool dma_transfer (struct ata_disk *, block_sector_t, void *,
+                          size_t cnt, bool write);
+
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
@@ -101,6 +157,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -126,6 +183,18 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+
+      /* pseudOS: Set up bus-master DMA if the controller has it. */
+      c->bm_base = 0;
+      c->prdt = NULL;
+      c->active = NULL;
+      c->issue_cycles = 0;
+      if (bm_base != 0)
+        {
+          c->prdt = palloc_get_page (0);
+          if (c->prdt != NULL)
+            c->bm_base = bm_base + chan_no * 8;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +205,8 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
+          d->block = NULL;
         }
 
       /* Register interrupt handler. */
@@ -289,6 +360,11 @@ identify_ata_device (struct ata_disk *d)
   snprintf (extra_info, sizeof extra_info,
             "model \"%s\", serial \"%s\"", model, serial);
 
+  /* pseudOS: Word 49 bit 8 tells whether the disk supports DMA. */
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100) != 0;
+  if (d->dma)
+    strlcat (extra_info, ", DMA", sizeof extra_info);
+
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
      allow access to those, we're less likely to scribble on
@@ -306,6 +382,7 @@ identify_ata_device (struct ata_disk *d)
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
+  d->block = block;
   partition_scan (block);
 }
 
@@ -342,18 +419,9 @@ descramble_ata_string (char *string, int size)
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read (void *d, block_sector_t sec_no, void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  ide_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -362,38 +430,113 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
+{
+  ide_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* pseudOS: Reads CNT sectors starting at SEC_NO from disk D into
+   BUFFER, issuing one command per MAX_SECTORS_PER_CMD sectors.
+   Uses DMA if possible, PIO otherwise. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, void *buffer,
+                   size_t cnt)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  uint8_t *p = buffer;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t i;
+
+      if (!dma_transfer (d, sec_no, p, n, false))
+        {
+          /* The disk interrupts once for each sector that is ready
+             to be read. */
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+          for (i = 0; i < n; i++)
+            {
+              sema_down (&c->completion_wait);
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              input_sector (c, p + i * BLOCK_SECTOR_SIZE);
+            }
+        }
+      sec_no += n;
+      p += n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
+  lock_release (&c->lock);
+}
+
+/* pseudOS: Writes CNT sectors starting at SEC_NO to disk D from
+   BUFFER, issuing one command per MAX_SECTORS_PER_CMD sectors.
+   Returns after the disk has acknowledged receiving the data.
+   Uses DMA if possible, PIO otherwise. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, const void *buffer,
+                    size_t cnt)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  const uint8_t *p = buffer;
+
+  lock_acquire (&c->lock);
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t i;
+
+      if (!dma_transfer (d, sec_no, (void *) p, n, true))
+        {
+          /* The disk asks for each sector in turn and interrupts
+             once it has received it. */
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+          for (i = 0; i < n; i++)
+            {
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              output_sector (c, p + i * BLOCK_SECTOR_SIZE);
+              sema_down (&c->completion_wait);
+            }
+        }
+      sec_no += n;
+      p += n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
   lock_release (&c->lock);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple
   };
-
+
 /* Selects device D, waiting for it to become ready, and then
    writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   use LBA mode.)
+   pseudOS: CNT is the number of sectors to transfer, at most
+   MAX_SECTORS_PER_CMD. */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -411,6 +554,7 @@ issue_pio_command (struct channel *c, uint8_t command)
   ASSERT (intr_get_level () == INTR_ON);
 
   c->expecting_interrupt = true;
+  c->issue_cycles = timer_cycles ();
   outb (reg_command (c), command);
 }
 
@@ -430,6 +574,134 @@ output_sector (struct channel *c, const void *sector)
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
+/* pseudOS: Bus-master DMA. */
+
+/* PCI configuration space ports. */
+#define PCI_CONFIG_ADDRESS 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Reads the 32-bit register at offset REG of the configuration
+   space of PCI device DEV, function FUNC on bus 0. */
+static uint32_t
+pci_read_config (int dev, int func, int reg)
+{
+  outl (PCI_CONFIG_ADDRESS, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes DATA to the 32-bit register at offset REG of the
+   configuration space of PCI device DEV, function FUNC on
+   bus 0. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t data)
+{
+  outl (PCI_CONFIG_ADDRESS, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, data);
+}
+
+/* Looks on PCI bus 0 for an IDE controller capable of bus
+   mastering, such as the PIIX that QEMU emulates, and enables
+   bus mastering on it.  Returns the I/O port base of its
+   bus-master registers, or 0 if there is no such controller. */
+static uint16_t
+find_bus_master (void)
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t id = pci_read_config (dev, func, 0x00);
+        uint32_t class = pci_read_config (dev, func, 0x08);
+        uint32_t bar4;
+
+        if ((id & 0xffff) == 0xffff)
+          {
+            if (func == 0)
+              break;
+            continue;
+          }
+
+        /* Class 01h (mass storage), subclass 01h (IDE),
+           programming interface bit 7 (bus master). */
+        if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+          continue;
+        bar4 = pci_read_config (dev, func, 0x20);
+        if ((bar4 & 1) == 0)
+          continue;
+
+        /* Enable I/O space and bus master in the Command
+           register. */
+        pci_write_config (dev, func, 0x04,
+                          pci_read_config (dev, func, 0x04) | 0x5);
+        return bar4 & 0xfffc;
+      }
+  return 0;
+}
+
+/* Fills channel C's PRD table to describe the SIZE bytes of
+   kernel memory at BUFFER.  Returns false if BUFFER cannot be
+   used for DMA, in which case the caller must fall back to PIO. */
+static bool
+prepare_prdt (struct channel *c, const void *buffer, size_t size)
+{
+  uintptr_t phys;
+  size_t i = 0;
+
+  if (!is_kernel_vaddr (buffer) || ((uintptr_t) buffer & 1) != 0)
+    return false;
+
+  phys = vtop (buffer);
+  while (size > 0)
+    {
+      size_t chunk = 0x10000 - (phys & 0xffff);
+      if (chunk > size)
+        chunk = size;
+      if (i >= PRD_CNT)
+        return false;
+
+      c->prdt[i].addr = phys;
+      c->prdt[i].size = chunk & 0xffff;
+      c->prdt[i].flags = 0;
+      phys += chunk;
+      size -= chunk;
+      i++;
+    }
+  c->prdt[i - 1].flags = PRD_EOT;
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  return true;
+}
+
+/* Transfers CNT sectors starting at SEC_NO of disk D from or, if
+   WRITE is true, to BUFFER by bus-master DMA, sleeping until the
+   controller interrupts.  D's channel lock must be held.  Returns false
+   without doing anything if D or BUFFER is not suitable for
+   DMA. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, void *buffer,
+              size_t cnt, bool write)
+{
+  struct channel *c = d->channel;
+  uint8_t direction = write ? 0 : BM_CMD_READ;
+
+  if (!d->dma || !prepare_prdt (c, buffer, cnt * BLOCK_SECTOR_SIZE))
+    return false;
+
+  outb (reg_bm_command (c), direction);
+  outb (reg_bm_status (c), inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_IRQ);
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), direction | BM_CMD_START);
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), direction);
+
+  if ((c->bm_status & BM_STA_ERR) != 0
+      || (inb (reg_alt_status (c)) & STA_ERR) != 0)
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sec_no);
+  return true;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -487,6 +759,7 @@ select_device (const struct ata_disk *d)
   uint8_t dev = DEV_MBS;
   if (d->dev_no == 1)
     dev |= DEV_DEV;
+  c->active = d;
   outb (reg_device (c), dev);
   inb (reg_alt_status (c));
   timer_nsleep (400);
@@ -513,7 +786,24 @@ interrupt_handler (struct intr_frame *f)
       {
         if (c->expecting_interrupt) 
           {
+            /* pseudOS: Acknowledge the bus-master interrupt, too. */
+            if (c->bm_base != 0)
+              {
+                c->bm_status = inb (reg_bm_status (c));
+                outb (reg_bm_status (c), c->bm_status);
+              }
             inb (reg_status (c));               /* Acknowledge interrupt. */
+
+            /* pseudOS: Account the time since the command was
+               issued, or since the last interrupt for multi-sector
+               PIO, to the device. */
+            if (c->active != NULL && c->active->block != NULL)
+              {
+                uint64_t now = timer_cycles ();
+                block_record_service (c->active->block,
+                                      now - c->issue_cycles);
+                c->issue_cycles = now;
+              }
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
@@ -5,6 +5,7 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -13,6 +14,9 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/zswap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -129,6 +133,10 @@ print_stats (void)
 #ifdef FILESYS
   block_print_stats ();
 #endif
+#ifdef VM
+  zswap_print_stats ();
+#endif
+  slab_print_stats ();
   console_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
@@ -90,6 +90,16 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* pseudOS: Returns the CPU's time-stamp counter, which counts
+   cycles since the CPU was reset. */
+uint64_t
+timer_cycles (void)
+{
+  uint64_t t;
+  asm volatile ("rdtsc" : "=A" (t));
+  return t;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
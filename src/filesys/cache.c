@@ -0,0 +1,518 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* pseudOS: Write-back buffer cache of file system sectors.
+
+   Every access to fs_device goes through this cache.  Entries
+   are replaced with the clock algorithm and dirty entries are
+   only written to disk when they are evicted or flushed.
+
+   All entry metadata and the sector data itself are protected
+   by cache_lock.  Disk I/O is done without holding the lock; the
+   entry is marked busy for that time, and threads that want to
+   use a busy entry wait on io_done.
+
+   Sectors passed to cache_read_ahead() are queued and loaded by
+   the "read-ahead" kernel thread in the background.  Runs of
+   consecutive queued sectors are read with a single multi-sector
+   request.
+
+   The "flusher" kernel thread wakes up every
+   cache_flush_interval ticks and writes all dirty entries back
+   at once, as asynchronous requests that the block layer sorts
+   and merges.  Writers do the same
+   themselves once more than cache_dirty_ratio percent of the
+   cache is dirty. */
+
+/* pseudOS: Maximum number of pending read-ahead requests.
+   Requests beyond this are dropped. */
+#define READ_AHEAD_QUEUE_SIZE 32
+
+/* pseudOS: Most consecutive sectors transferred by one request,
+   limited by the page used to gather them. */
+#define CACHE_RUN_MAX (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A cached sector. */
+struct cache_entry
+  {
+    block_sector_t sector;      /* Cached sector, if valid. */
+    bool valid;                 /* Does DATA hold SECTOR's content? */
+    bool dirty;                 /* Must DATA be written back? */
+    bool accessed;              /* Used since the clock hand passed? */
+    bool busy;                  /* Disk I/O in progress? */
+    bool prefetched;            /* Read ahead and not used since? */
+    uint8_t *data;              /* BLOCK_SECTOR_SIZE bytes. */
+  };
+
+/* pseudOS: Write-behind tuning.
+   Controlled by kernel command-line options "-flush" and "-dirty". */
+int cache_flush_interval = CACHE_FLUSH_INTERVAL_DEFAULT;
+int cache_dirty_ratio = CACHE_DIRTY_RATIO_DEFAULT;
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static struct condition io_done;
+static size_t clock_hand;
+static size_t dirty_cnt;                /* Number of dirty entries. */
+
+/* Ring buffer of sectors waiting to be read ahead. */
+static block_sector_t read_ahead_queue[READ_AHEAD_QUEUE_SIZE];
+static size_t read_ahead_head;          /* Next request to serve. */
+static size_t read_ahead_cnt;           /* Number of pending requests. */
+static struct condition read_ahead_ready;
+
+static thread_func read_ahead_daemon NO_RETURN;
+static thread_func flusher_daemon NO_RETURN;
+static struct cache_entry *cache_lookup (block_sector_t, bool need_read);
+static struct cache_entry *cache_load (block_sector_t, bool need_read);
+static struct cache_entry *cache_find (block_sector_t);
+static struct cache_entry *cache_select_victim (void);
+static struct cache_entry *cache_claim (block_sector_t);
+static void cache_assign (struct cache_entry *, block_sector_t);
+static block_sector_t read_ahead_pop (void);
+static void cache_write_back (struct cache_entry *);
+static void cache_write_behind (void);
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  size_t pages = CACHE_SIZE * BLOCK_SECTOR_SIZE / PGSIZE;
+  uint8_t *data = palloc_get_multiple (PAL_ASSERT, pages);
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *ce = &cache[i];
+      ce->valid = false;
+      ce->dirty = false;
+      ce->accessed = false;
+      ce->busy = false;
+      ce->prefetched = false;
+      ce->data = data + i * BLOCK_SECTOR_SIZE;
+    }
+  lock_init (&cache_lock);
+  cond_init (&io_done);
+  clock_hand = 0;
+  dirty_cnt = 0;
+
+  read_ahead_head = 0;
+  read_ahead_cnt = 0;
+  cond_init (&read_ahead_ready);
+  thread_create ("read-ahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+  thread_create ("flusher", PRI_DEFAULT, flusher_daemon, NULL);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, BLOCK_SECTOR_SIZE, 0);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within sector
+   SECTOR into BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, off_t size, off_t ofs)
+{
+  struct cache_entry *ce;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  ce = cache_lookup (sector, true);
+  memcpy (buffer, ce->data + ofs, size);
+  lock_release (&cache_lock);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER into sector
+   SECTOR. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, BLOCK_SECTOR_SIZE, 0);
+}
+
+/* Writes SIZE bytes from BUFFER into sector SECTOR, starting at
+   byte offset OFS within the sector.  The sector is only read
+   from disk first if the write does not cover all of it. */
+void
+cache_write_at (block_sector_t sector, const void *buffer, off_t size,
+                off_t ofs)
+{
+  struct cache_entry *ce;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  ce = cache_lookup (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (ce->data + ofs, buffer, size);
+  if (!ce->dirty)
+    {
+      ce->dirty = true;
+      dirty_cnt++;
+    }
+  if (dirty_cnt * 100 > (size_t) cache_dirty_ratio * CACHE_SIZE)
+    cache_write_behind ();
+  lock_release (&cache_lock);
+}
+
+/* Asks the read-ahead thread to load SECTOR into the cache
+   without waiting for it.  Does nothing if SECTOR is already
+   cached or too many requests are pending. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  lock_acquire (&cache_lock);
+  if (cache_find (sector) == NULL
+      && read_ahead_cnt < READ_AHEAD_QUEUE_SIZE)
+    {
+      size_t tail = ((read_ahead_head + read_ahead_cnt)
+                     % READ_AHEAD_QUEUE_SIZE);
+      read_ahead_queue[tail] = sector;
+      read_ahead_cnt++;
+      cond_signal (&read_ahead_ready, &cache_lock);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes every dirty entry back to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  cache_write_behind ();
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *ce = &cache[i];
+      while (ce->busy)
+        cond_wait (&io_done, &cache_lock);
+      if (ce->valid && ce->dirty)
+        cache_write_back (ce);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry caching SECTOR, loading it into the cache
+   first if necessary.  If NEED_READ is false the caller is about
+   to overwrite the whole sector, so a missing sector is not read
+   from disk.
+   Must be called with cache_lock held.  The returned entry is
+   valid and not busy for as long as cache_lock stays held. */
+static struct cache_entry *
+cache_lookup (block_sector_t sector, bool need_read)
+{
+  struct cache_entry *ce;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (;;)
+    {
+      ce = cache_find (sector);
+      if (ce != NULL)
+        {
+          if (ce->busy)
+            {
+              cond_wait (&io_done, &cache_lock);
+              continue;
+            }
+          block_record_cache_access (fs_device, true);
+          if (ce->prefetched)
+            {
+              block_record_read_ahead (fs_device, true);
+              ce->prefetched = false;
+            }
+          ce->accessed = true;
+          return ce;
+        }
+
+      ce = cache_load (sector, need_read);
+      if (ce != NULL)
+        {
+          block_record_cache_access (fs_device, false);
+          return ce;
+        }
+    }
+}
+
+/* Replaces an entry by SECTOR, which must not be cached, and
+   reads SECTOR from disk if NEED_READ is true.
+   Returns a null pointer instead if the cache changed while
+   waiting for an entry to become replaceable, in which case the
+   caller must look SECTOR up again.
+   Must be called with cache_lock held. */
+static struct cache_entry *
+cache_load (block_sector_t sector, bool need_read)
+{
+  struct cache_entry *ce;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  ce = cache_select_victim ();
+  if (ce == NULL)
+    {
+      cond_wait (&io_done, &cache_lock);
+      return NULL;
+    }
+  if (ce->valid && ce->dirty)
+    {
+      cache_write_back (ce);
+      return NULL;
+    }
+
+  cache_assign (ce, sector);
+  if (need_read)
+    {
+      ce->busy = true;
+      lock_release (&cache_lock);
+      block_read (fs_device, sector, ce->data);
+      lock_acquire (&cache_lock);
+      ce->busy = false;
+      cond_broadcast (&io_done, &cache_lock);
+    }
+  return ce;
+}
+
+/* Returns the entry caching SECTOR or a null pointer if SECTOR
+   is not cached. */
+static struct cache_entry *
+cache_find (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Advances the clock hand to an entry that may be replaced and
+   returns it, giving recently accessed entries a second chance.
+   Returns a null pointer if every entry is busy. */
+static struct cache_entry *
+cache_select_victim (void)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *ce = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (ce->busy)
+        continue;
+      if (!ce->valid || !ce->accessed)
+        return ce;
+      ce->accessed = false;
+    }
+  return NULL;
+}
+
+/* pseudOS: Replaces a clean entry by SECTOR, which must not be
+   cached, and marks it busy so that the caller can fill it in
+   with cache_lock released.  Unlike cache_load(), never waits or
+   writes anything back; returns a null pointer if that would be
+   necessary. */
+static struct cache_entry *
+cache_claim (block_sector_t sector)
+{
+  struct cache_entry *ce = cache_select_victim ();
+
+  if (ce == NULL || (ce->valid && ce->dirty))
+    return NULL;
+  cache_assign (ce, sector);
+  ce->busy = true;
+  return ce;
+}
+
+/* pseudOS: Makes the replaceable, clean entry CE cache SECTOR. */
+static void
+cache_assign (struct cache_entry *ce, block_sector_t sector)
+{
+  ASSERT (!ce->busy && !(ce->valid && ce->dirty));
+
+  if (ce->valid && ce->prefetched)
+    block_record_read_ahead (fs_device, false);
+  ce->sector = sector;
+  ce->valid = true;
+  ce->dirty = false;
+  ce->accessed = true;
+  ce->prefetched = false;
+}
+
+/* Writes the dirty entry CE back to disk, releasing cache_lock
+   during the write. */
+static void
+cache_write_back (struct cache_entry *ce)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  ASSERT (ce->valid && ce->dirty && !ce->busy);
+
+  ce->busy = true;
+  ce->dirty = false;
+  dirty_cnt--;
+  lock_release (&cache_lock);
+  block_write (fs_device, ce->sector, ce->data);
+  lock_acquire (&cache_lock);
+  ce->busy = false;
+  cond_broadcast (&io_done, &cache_lock);
+}
+
+/* Thread function for the read-ahead thread.  Loads queued
+   sectors into the cache, marking them as prefetched. */
+static void
+read_ahead_daemon (void *aux UNUSED)
+{
+  uint8_t *run_data = palloc_get_page (PAL_ASSERT);
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      struct cache_entry *run[CACHE_RUN_MAX];
+      block_sector_t sector;
+      size_t cnt = 0;
+      size_t i;
+
+      while (read_ahead_cnt == 0)
+        cond_wait (&read_ahead_ready, &cache_lock);
+      sector = read_ahead_pop ();
+      if (cache_find (sector) != NULL)
+        continue;
+
+      /* pseudOS: Claim entries for SECTOR and for as many of the
+         following requests as continue it. */
+      for (;;)
+        {
+          struct cache_entry *ce = cache_claim (sector + cnt);
+          if (ce == NULL)
+            break;
+          run[cnt++] = ce;
+          if (cnt == CACHE_RUN_MAX
+              || read_ahead_cnt == 0
+              || read_ahead_queue[read_ahead_head] != sector + cnt
+              || cache_find (sector + cnt) != NULL)
+            break;
+          read_ahead_pop ();
+        }
+
+      if (cnt == 0)
+        {
+          /* No clean entry to claim; wait or write back as a
+             regular miss would. */
+          struct cache_entry *ce = NULL;
+          while (cache_find (sector) == NULL
+                 && (ce = cache_load (sector, true)) == NULL)
+            continue;
+          if (ce != NULL)
+            ce->prefetched = true;
+          continue;
+        }
+
+      lock_release (&cache_lock);
+      block_read_multiple (fs_device, sector, run_data, cnt);
+      lock_acquire (&cache_lock);
+      for (i = 0; i < cnt; i++)
+        {
+          memcpy (run[i]->data, run_data + i * BLOCK_SECTOR_SIZE,
+                  BLOCK_SECTOR_SIZE);
+          run[i]->busy = false;
+          run[i]->prefetched = true;
+        }
+      cond_broadcast (&io_done, &cache_lock);
+    }
+}
+
+/* pseudOS: Removes and returns the oldest read-ahead request.
+   There must be one. */
+static block_sector_t
+read_ahead_pop (void)
+{
+  block_sector_t sector = read_ahead_queue[read_ahead_head];
+
+  ASSERT (read_ahead_cnt > 0);
+  read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_QUEUE_SIZE;
+  read_ahead_cnt--;
+  return sector;
+}
+
+/* Writes all dirty entries that are not busy back to disk in
+   ascending sector order, releasing cache_lock during the
+   writes.
+   Must be called with cache_lock held. */
+static void
+cache_write_behind (void)
+{
+  struct cache_entry *batch[CACHE_SIZE];
+  struct block_request *requests;
+  size_t cnt = 0;
+  size_t i, j;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Collect the dirty entries, sorted by sector. */
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *ce = &cache[i];
+      if (!ce->valid || !ce->dirty || ce->busy)
+        continue;
+      for (j = cnt; j > 0 && batch[j - 1]->sector > ce->sector; j--)
+        batch[j] = batch[j - 1];
+      batch[j] = ce;
+      cnt++;
+
+      ce->busy = true;
+      ce->dirty = false;
+      dirty_cnt--;
+    }
+  if (cnt == 0)
+    return;
+
+  /* pseudOS: Submit all the writes before waiting for any, so
+     that the block layer can merge consecutive sectors.  Without
+     memory for the requests, write one sector at a time. */
+  lock_release (&cache_lock);
+  requests = malloc (cnt * sizeof *requests);
+  for (i = 0; i < cnt; i++)
+    if (requests != NULL)
+      {
+        block_request_init (&requests[i], true, batch[i]->sector,
+                            batch[i]->data, 1);
+        block_submit (fs_device, &requests[i]);
+      }
+    else
+      block_write (fs_device, batch[i]->sector, batch[i]->data);
+  if (requests != NULL)
+    for (i = 0; i < cnt; i++)
+      block_wait (&requests[i]);
+  free (requests);
+  lock_acquire (&cache_lock);
+
+  for (i = 0; i < cnt; i++)
+    batch[i]->busy = false;
+  cond_broadcast (&io_done, &cache_lock);
+}
+
+/* Thread function for the flusher thread.  Periodically writes
+   dirty entries back to disk. */
+static void
+flusher_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (cache_flush_interval > 0 ? cache_flush_interval : 1);
+      lock_acquire (&cache_lock);
+      cache_write_behind ();
+      lock_release (&cache_lock);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "filesys/off_t.h"
+
+/* pseudOS: Number of sectors held by the buffer cache. */
+#define CACHE_SIZE 64
+
+/* pseudOS: Default ticks between write-behind passes and default
+   percentage of dirty entries that forces one. */
+#define CACHE_FLUSH_INTERVAL_DEFAULT (TIMER_FREQ)
+#define CACHE_DIRTY_RATIO_DEFAULT 50
+
+extern int cache_flush_interval;
+extern int cache_dirty_ratio;
+
+void cache_init (void);
+void cache_read (block_sector_t, void *);
+void cache_read_at (block_sector_t, void *, off_t size, off_t ofs);
+void cache_write (block_sector_t, const void *);
+void cache_write_at (block_sector_t, const void *, off_t size, off_t ofs);
+void cache_read_ahead (block_sector_t);
+void cache_flush (void);
+
+#endif /* filesys/cache.h */
@@ -0,0 +1,171 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* pseudOS: Directory entry cache.
+
+   Remembers the result of looking up a name in a directory,
+   keyed by the directory's inode sector and the name, so that
+   repeated lookups do not have to scan the directory.  A
+   negative entry, with inode_sector 0, records that the name
+   does not exist.  The directory code keeps the cache in sync
+   by inserting the new result whenever it adds or removes an
+   entry.
+
+   Entries live in a fixed array and are replaced in least
+   recently used order.  dcache_lock protects all of them. */
+
+/* A cached name. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dentries. */
+    struct list_elem lru_elem;          /* Element in lru_list. */
+    bool valid;                         /* In use? */
+    block_sector_t dir;                 /* Directory inode sector. */
+    char name[NAME_MAX + 1];            /* Null terminated name. */
+    block_sector_t inode_sector;        /* Inode sector, 0 if negative. */
+    off_t ofs;                          /* Offset of the entry in DIR. */
+  };
+
+static struct dentry dentries_array[DCACHE_SIZE];
+static struct hash dentries;
+static struct list lru_list;            /* Most recently used first. */
+static struct lock dcache_lock;
+
+static struct dentry *dentry_find (block_sector_t dir, const char *name);
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  hash_init (&dentries, dentry_hash, dentry_less, NULL);
+  list_init (&lru_list);
+  lock_init (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      dentries_array[i].valid = false;
+      list_push_back (&lru_list, &dentries_array[i].lru_elem);
+    }
+}
+
+/* Looks up NAME in directory DIR.  Returns false if the cache
+   knows nothing about it.  Otherwise, returns true and stores
+   the inode sector, or 0 if NAME does not exist in DIR, in
+   *INODE_SECTOR and the entry's offset in *OFS. */
+bool
+dcache_lookup (block_sector_t dir, const char *name,
+               block_sector_t *inode_sector, off_t *ofs)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&lru_list, &d->lru_elem);
+      *inode_sector = d->inode_sector;
+      *ofs = d->ofs;
+    }
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Records that NAME in directory DIR refers to INODE_SECTOR in
+   the entry at OFS, or that it does not exist if INODE_SECTOR is
+   0.  Replaces whatever was cached for NAME before.  Names too
+   long to exist are not cached. */
+void
+dcache_insert (block_sector_t dir, const char *name,
+               block_sector_t inode_sector, off_t ofs)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d == NULL)
+    {
+      d = list_entry (list_back (&lru_list), struct dentry, lru_elem);
+      if (d->valid)
+        hash_delete (&dentries, &d->hash_elem);
+      d->valid = true;
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dentries, &d->hash_elem);
+    }
+  d->inode_sector = inode_sector;
+  d->ofs = ofs;
+  list_remove (&d->lru_elem);
+  list_push_front (&lru_list, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets everything cached about directory DIR, whose sector is
+   about to hold a new directory. */
+void
+dcache_purge (block_sector_t dir)
+{
+  size_t i;
+
+  lock_acquire (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      struct dentry *d = &dentries_array[i];
+      if (d->valid && d->dir == dir)
+        {
+          hash_delete (&dentries, &d->hash_elem);
+          d->valid = false;
+          list_remove (&d->lru_elem);
+          list_push_back (&lru_list, &d->lru_elem);
+        }
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns the valid dentry for NAME in DIR, or a null pointer if
+   there is none.  dcache_lock must be held. */
+static struct dentry *
+dentry_find (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Hash and comparison functions for dentries. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
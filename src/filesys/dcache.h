@@ -0,0 +1,18 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* pseudOS: Number of names held by the directory entry cache. */
+#define DCACHE_SIZE 256
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t dir, const char *name,
+                    block_sector_t *inode_sector, off_t *ofs);
+void dcache_insert (block_sector_t dir, const char *name,
+                    block_sector_t inode_sector, off_t ofs);
+void dcache_purge (block_sector_t dir);
+
+#endif /* filesys/dcache.h */
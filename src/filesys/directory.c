@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -21,12 +22,35 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* pseudOS: Number of directory entries read at a time while
+   scanning a directory. */
+#define ENTRY_BATCH (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+static off_t scan (const struct dir *, const char *name,
+                   struct dir_entry *ep);
+static bool is_dot (const char *name);
+static bool dir_is_empty (const struct dir *);
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR.  Returns true if successful, false on failure.
+   pseudOS: The directory's "." and ".." entries refer to SECTOR
+   and PARENT, respectively. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, size_t entry_cnt, block_sector_t parent)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir *dir;
+  bool success;
+
+  dcache_purge (sector);
+  if (!inode_create (sector, entry_cnt * sizeof (struct dir_entry), true))
+    return false;
+
+  dir = dir_open (inode_open (sector));
+  success = (dir != NULL
+             && dir_add (dir, ".", sector)
+             && dir_add (dir, "..", parent));
+  dir_close (dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -83,32 +107,90 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* pseudOS: Sets DIR's dir_readdir() position to POS, which must
+   have been returned by dir_tell(). */
+void
+dir_seek (struct dir *dir, off_t pos)
+{
+  dir->pos = pos;
+}
+
+/* pseudOS: Returns DIR's dir_readdir() position. */
+off_t
+dir_tell (const struct dir *dir)
+{
+  return dir->pos;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   pseudOS: Consults the directory entry cache first and records
+   the outcome there, whether the name exists or not. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
+  block_sector_t dir_sector;
   struct dir_entry e;
-  size_t ofs;
+  off_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
-  return false;
+  dir_sector = inode_get_inumber (dir->inode);
+  if (dcache_lookup (dir_sector, name, &e.inode_sector, &ofs))
+    {
+      if (e.inode_sector == 0)
+        return false;
+      strlcpy (e.name, name, sizeof e.name);
+      e.in_use = true;
+    }
+  else
+    {
+      ofs = scan (dir, name, &e);
+      dcache_insert (dir_sector, name, ofs >= 0 ? e.inode_sector : 0, ofs);
+      if (ofs < 0)
+        return false;
+    }
+
+  if (ep != NULL)
+    *ep = e;
+  if (ofsp != NULL)
+    *ofsp = ofs;
+  return true;
+}
+
+/* pseudOS: Searches DIR for the entry named NAME, or for the first
+   free entry if NAME is a null pointer, reading ENTRY_BATCH
+   entries per inode_read_at() call.  Returns the entry's offset
+   and copies it into *EP.  Returns -1 if there is no such entry,
+   or the current end-of-file if NAME is a null pointer and there
+   are no free entries. */
+static off_t
+scan (const struct dir *dir, const char *name, struct dir_entry *ep)
+{
+  struct dir_entry entries[ENTRY_BATCH];
+  off_t ofs = 0;
+
+  for (;;)
+    {
+      off_t n = inode_read_at (dir->inode, entries, sizeof entries, ofs);
+      size_t i;
+
+      for (i = 0; i < n / sizeof *entries; i++, ofs += sizeof *entries)
+        if (name != NULL
+            ? entries[i].in_use && !strcmp (name, entries[i].name)
+            : !entries[i].in_use)
+          {
+            *ep = entries[i];
+            return ofs;
+          }
+      if (n < (off_t) sizeof entries)
+        return name != NULL ? -1 : ofs;
+    }
 }
 
 /* Searches DIR for a file with the given NAME
@@ -132,6 +214,37 @@ dir_lookup (const struct dir *dir, const char *name,
   return *inode != NULL;
 }
 
+/* pseudOS: Looks up NAME in the directory whose inode is in
+   sector DIR and stores the inode sector of the entry in
+   *SECTORP.  Returns false if there is no such entry or if DIR
+   is not a directory.
+   Unlike dir_lookup(), this answers from the directory entry
+   cache without opening DIR when it can, which makes walking the
+   intermediate directories of a path cheap.  Only sectors that
+   hold a directory ever have cached entries. */
+bool
+dir_lookup_sector (block_sector_t dir_sector, const char *name,
+                   block_sector_t *sectorp)
+{
+  struct dir_entry e;
+  struct dir *dir;
+  off_t ofs;
+  bool found;
+
+  if (dcache_lookup (dir_sector, name, sectorp, &ofs))
+    return *sectorp != 0;
+
+  dir = dir_open (inode_open (dir_sector));
+  if (dir == NULL)
+    return false;
+  found = inode_is_dir (dir->inode) && lookup (dir, name, &e, NULL);
+  dir_close (dir);
+
+  if (found)
+    *sectorp = e.inode_sector;
+  return found;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
@@ -163,16 +276,15 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  ofs = scan (dir, NULL, &e);
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector, ofs);
 
  done:
   return success;
@@ -180,7 +292,10 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   which occurs only if there is no file with the given NAME.
+   pseudOS: Also fails for "." and "..", for directories that are
+   not empty and for directories that someone else has open,
+   including as a working directory. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
@@ -193,7 +308,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (is_dot (name) || !lookup (dir, name, &e, &ofs))
     goto done;
 
   /* Open inode. */
@@ -201,10 +316,27 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* pseudOS: Only remove empty directories nobody else uses. */
+  if (inode_is_dir (inode))
+    {
+      struct dir *victim;
+      bool empty;
+
+      if (inode_open_cnt (inode) > 1)
+        goto done;
+      victim = dir_open (inode_reopen (inode));
+      empty = victim != NULL && dir_is_empty (victim);
+      dir_close (victim);
+      if (!empty)
+        goto done;
+      dcache_purge (e.inode_sector);
+    }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_insert (inode_get_inumber (dir->inode), name, 0, -1);
 
   /* Remove inode. */
   inode_remove (inode);
@@ -226,7 +358,7 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
-      if (e.in_use)
+      if (e.in_use && !is_dot (e.name))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
           return true;
@@ -234,3 +366,25 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
     }
   return false;
 }
+
+/* pseudOS: Returns true if NAME is "." or "..". */
+static bool
+is_dot (const char *name)
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
+
+/* pseudOS: Returns true if DIR has no entries besides "." and
+   "..". */
+static bool
+dir_is_empty (const struct dir *dir)
+{
+  struct dir_entry e;
+  off_t ofs;
+
+  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (e.in_use && !is_dot (e.name))
+      return false;
+  return true;
+}
@@ -1,7 +1,15 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+
+/* pseudOS: Read-ahead window, in sectors.  The window starts at
+   READ_AHEAD_MIN sectors on the first sequential read, doubles
+   with every further one up to READ_AHEAD_MAX and collapses to 0
+   as soon as the file is read out of order. */
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 16
 
 /* An open file. */
 struct file 
@@ -9,26 +17,44 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ra_next;              /* pseudOS: Offset of a sequential read. */
+    off_t ra_end;               /* pseudOS: End of requested read-ahead. */
+    int ra_window;              /* pseudOS: Read-ahead window in sectors. */
   };
 
+/* pseudOS: Cache of open files. */
+static struct slab_cache file_cache;
+
+static void file_read_ahead (struct file *, off_t ofs, off_t size);
+
+/* pseudOS: Initializes the cache of open files. */
+void
+file_init (void) 
+{
+  slab_cache_init (&file_cache, "file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = slab_alloc (&file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      slab_free (&file_cache, file);
       return NULL; 
     }
 }
@@ -49,7 +75,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      slab_free (&file_cache, file); 
     }
 }
 
@@ -69,6 +95,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  file_read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -87,9 +114,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +128,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -166,3 +191,35 @@ file_tell (struct file *file)
   ASSERT (file != NULL);
   return file->pos;
 }
+
+/* pseudOS: Updates FILE's read-ahead window after SIZE bytes were
+   read at offset OFS and asks for the sectors in the window
+   beyond OFS + SIZE that have not been requested yet. */
+static void
+file_read_ahead (struct file *file, off_t ofs, off_t size)
+{
+  off_t start, end;
+
+  if (ofs != file->ra_next)
+    {
+      /* Random access: drop the window. */
+      file->ra_window = 0;
+      file->ra_end = 0;
+    }
+  else if (file->ra_window == 0)
+    file->ra_window = READ_AHEAD_MIN;
+  else if (file->ra_window < READ_AHEAD_MAX)
+    file->ra_window *= 2;
+  file->ra_next = ofs + size;
+
+  if (file->ra_window == 0 || size == 0)
+    return;
+
+  start = file->ra_next > file->ra_end ? file->ra_next : file->ra_end;
+  end = file->ra_next + file->ra_window * BLOCK_SECTOR_SIZE;
+  if (start < end)
+    {
+      inode_read_ahead (file->inode, start, end - start);
+      file->ra_end = end;
+    }
+}
@@ -2,15 +2,24 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* pseudOS: The root directory stays open while the file system
+   is mounted, so that resolving absolute paths never has to read
+   its inode again. */
+static struct inode *root_inode;
+
 static void do_format (void);
+static struct dir *resolve (const char *path, char name[NAME_MAX + 1]);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -21,6 +30,9 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
+  dcache_init ();
+  file_init ();
   inode_init ();
   free_map_init ();
 
@@ -28,6 +40,10 @@ filesys_init (bool format)
     do_format ();
 
   free_map_open ();
+
+  root_inode = inode_open (ROOT_DIR_SECTOR);
+  if (root_inode == NULL)
+    PANIC ("can't open root directory");
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -35,22 +51,26 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  inode_close (root_inode);
   free_map_close ();
+  cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
-   or if internal memory allocation fails. */
+   or if internal memory allocation fails.
+   pseudOS: NAME may be a relative or absolute path. */
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
+  char leaf[NAME_MAX + 1];
+  struct dir *dir = resolve (name, leaf);
   bool success = (dir != NULL
                   && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+                  && inode_create (inode_sector, initial_size, false)
+                  && dir_add (dir, leaf, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
@@ -66,11 +86,12 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
+  char leaf[NAME_MAX + 1];
+  struct dir *dir = resolve (name, leaf);
   struct inode *inode = NULL;
 
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    dir_lookup (dir, leaf, &inode);
   dir_close (dir);
 
   return file_open (inode);
@@ -83,12 +104,124 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char leaf[NAME_MAX + 1];
+  struct dir *dir = resolve (name, leaf);
+  bool success = dir != NULL && dir_remove (dir, leaf);
   dir_close (dir); 
 
   return success;
 }
+
+/* pseudOS: Creates a directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file or directory named NAME already exists, if
+   NAME's parent directory does not exist, or if internal memory
+   allocation fails. */
+bool
+filesys_mkdir (const char *name)
+{
+  block_sector_t inode_sector = 0;
+  char leaf[NAME_MAX + 1];
+  struct dir *dir = resolve (name, leaf);
+  bool success = (dir != NULL
+                  && free_map_allocate (1, &inode_sector)
+                  && dir_create (inode_sector, 16,
+                                 inode_get_inumber (dir_get_inode (dir)))
+                  && dir_add (dir, leaf, inode_sector));
+  if (!success && inode_sector != 0)
+    free_map_release (inode_sector, 1);
+  dir_close (dir);
+
+  return success;
+}
+
+/* pseudOS: Changes the running thread's working directory to
+   NAME.  Returns true if successful, false if NAME does not
+   exist or is not a directory. */
+bool
+filesys_chdir (const char *name)
+{
+  struct thread *t = thread_current ();
+  char leaf[NAME_MAX + 1];
+  struct dir *dir = resolve (name, leaf);
+  struct inode *inode = NULL;
+
+  if (dir != NULL)
+    dir_lookup (dir, leaf, &inode);
+  dir_close (dir);
+
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+  dir = dir_open (inode);
+  if (dir == NULL)
+    return false;
+  dir_close (t->cwd);
+  t->cwd = dir;
+  return true;
+}
+
+/* pseudOS: Splits PATH into the directory that holds its last
+   component and the component itself.  Opens and returns that
+   directory and copies the component into NAME.  A PATH that
+   ends in the directory itself, such as "/", yields the name
+   ".".  Relative paths start at the running thread's working
+   directory, or at the root directory if it has none.
+   Returns a null pointer if PATH is empty, if a component is too
+   long or if an intermediate directory does not exist.
+
+   Intermediate directories are looked up by sector, through the
+   directory entry cache, so they are not opened at all unless
+   the cache misses. */
+static struct dir *
+resolve (const char *path, char name[NAME_MAX + 1])
+{
+  struct thread *t = thread_current ();
+  block_sector_t sector;
+  bool have_name = false;
+  struct dir *dir;
+
+  if (*path == '\0')
+    return NULL;
+  if (*path == '/' || t->cwd == NULL)
+    sector = ROOT_DIR_SECTOR;
+  else
+    sector = inode_get_inumber (dir_get_inode (t->cwd));
+
+  for (;;)
+    {
+      size_t len;
+
+      while (*path == '/')
+        path++;
+      if (*path == '\0')
+        break;
+      len = strcspn (path, "/");
+      if (len > NAME_MAX)
+        return NULL;
+
+      /* Descend into the previous component, now that it is
+         known not to be the last one. */
+      if (have_name && !dir_lookup_sector (sector, name, &sector))
+        return NULL;
+      memcpy (name, path, len);
+      name[len] = '\0';
+      have_name = true;
+      path += len;
+    }
+  if (!have_name)
+    strlcpy (name, ".", NAME_MAX + 1);
+
+  dir = dir_open (inode_open (sector));
+  if (dir != NULL && !inode_is_dir (dir_get_inode (dir)))
+    {
+      dir_close (dir);
+      return NULL;
+    }
+  return dir;
+}
 
 /* Formats the file system. */
 static void
@@ -96,8 +229,9 @@ do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
+  cache_flush ();
   printf ("done.\n");
 }
@@ -1,22 +1,72 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* pseudOS: Number of free extent size buckets.  Bucket I holds
+   the extents of 2**I to 2**(I+1) - 1 sectors; the last bucket
+   also holds all larger extents. */
+#define EXTENT_BUCKET_CNT 16
+
+/* pseudOS: A run of free sectors. */
+struct extent
+  {
+    block_sector_t start;               /* First free sector. */
+    size_t length;                      /* Number of free sectors. */
+    struct list_elem bucket_elem;       /* Element in a size bucket. */
+    struct hash_elem start_elem;        /* Element in extents_by_start. */
+    struct hash_elem end_elem;          /* Element in extents_by_end. */
+  };
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct lock free_map_lock;    /* pseudOS: Protects the free map. */
+
+/* pseudOS: In-memory index of the free extents in free_map,
+   bucketed by size and hashed by first and one-past-last sector
+   so that released sectors can be merged with their neighbors.
+   If the index cannot be kept up to date because memory runs
+   out, extents_ok is cleared and the bitmap is scanned
+   instead. */
+static struct list extent_buckets[EXTENT_BUCKET_CNT];
+static struct hash extents_by_start;
+static struct hash extents_by_end;
+static bool extents_ok;
+
+static void extents_build (void);
+static void extents_clear (void);
+static bool extent_add (block_sector_t, size_t);
+static void extent_remove (struct extent *);
+static struct extent *extent_find (struct hash *, block_sector_t);
+static size_t extent_bucket (size_t length);
+static hash_hash_func extent_start_hash, extent_end_hash;
+static hash_less_func extent_start_less, extent_end_less;
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  size_t i;
+
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  lock_init (&free_map_lock);
+  for (i = 0; i < EXTENT_BUCKET_CNT; i++)
+    list_init (&extent_buckets[i]);
+  hash_init (&extents_by_start, extent_start_hash, extent_start_less, NULL);
+  hash_init (&extents_by_end, extent_end_hash, extent_end_less, NULL);
+  extents_build ();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,14 +77,68 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  return free_map_allocate_near (cnt, 0, sectorp);
+}
+
+/* pseudOS: As free_map_allocate(), but places the sectors at GOAL
+   if that is the start of a large enough free extent, e.g. right
+   behind the last sector a file got.  A GOAL of 0 expresses no
+   preference.  Otherwise first fit from the smallest size bucket
+   that can hold CNT sectors. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t goal,
+                        block_sector_t *sectorp)
+{
+  block_sector_t sector = BITMAP_ERROR;
+
+  lock_acquire (&free_map_lock);
+  if (!extents_ok)
+    extents_build ();
+  if (extents_ok)
+    {
+      struct extent *e = goal != 0 ? extent_find (&extents_by_start, goal)
+                                   : NULL;
+      size_t b;
+
+      if (e == NULL || e->length < cnt)
+        for (e = NULL, b = extent_bucket (cnt);
+             e == NULL && b < EXTENT_BUCKET_CNT; b++)
+          {
+            struct list_elem *le;
+
+            for (le = list_begin (&extent_buckets[b]);
+                 le != list_end (&extent_buckets[b]); le = list_next (le))
+              {
+                e = list_entry (le, struct extent, bucket_elem);
+                if (e->length >= cnt)
+                  break;
+                e = NULL;
+              }
+          }
+
+      if (e != NULL)
+        {
+          sector = e->start;
+          extent_remove (e);
+          if (e->length > cnt && !extent_add (sector + cnt, e->length - cnt))
+            extents_clear ();
+          free (e);
+          bitmap_set_multiple (free_map, sector, cnt, true);
+        }
+    }
+  else
+    sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+      && !bitmap_write_range (free_map, free_map_file, sector, cnt))
     {
       bitmap_set_multiple (free_map, sector, cnt, false); 
+      extents_clear ();
       sector = BITMAP_ERROR;
     }
+  lock_release (&free_map_lock);
+
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
@@ -44,9 +148,36 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  if (extents_ok)
+    {
+      /* pseudOS: Merge with the free neighbors on either side. */
+      struct extent *prev = extent_find (&extents_by_end, sector);
+      struct extent *next = extent_find (&extents_by_start, sector + cnt);
+      block_sector_t start = sector;
+      size_t length = cnt;
+
+      if (prev != NULL)
+        {
+          start = prev->start;
+          length += prev->length;
+          extent_remove (prev);
+          free (prev);
+        }
+      if (next != NULL)
+        {
+          length += next->length;
+          extent_remove (next);
+          free (next);
+        }
+      if (!extent_add (start, length))
+        extents_clear ();
+    }
+  if (free_map_file != NULL)
+    bitmap_write_range (free_map, free_map_file, sector, cnt);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,6 +189,7 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  extents_build ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -72,14 +204,201 @@ free_map_close (void)
 void
 free_map_create (void) 
 {
+  struct file *file;
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  /* Write bitmap to file.
+     pseudOS: The file's sectors are allocated by this first write,
+     so free_map_file must stay null until it is done.  Otherwise
+     each of these allocations would try to write the bitmap
+     again. */
+  file = file_open (inode_open (FREE_MAP_SECTOR));
+  if (file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
+  if (!bitmap_write (free_map, file))
     PANIC ("can't write free map");
+  free_map_file = file;
+}
+
+/* pseudOS: Prints the number of free sectors and a histogram of
+   the free extents by size. */
+void
+free_map_print_stats (void)
+{
+  size_t free_cnt, extent_cnt = 0, largest = 0;
+  size_t b;
+
+  lock_acquire (&free_map_lock);
+  free_cnt = bitmap_count (free_map, 0, bitmap_size (free_map), false);
+  printf ("Free space: %zu of %zu sectors free\n",
+          free_cnt, bitmap_size (free_map));
+  if (!extents_ok)
+    extents_build ();
+  if (extents_ok)
+    for (b = 0; b < EXTENT_BUCKET_CNT; b++)
+      {
+        size_t cnt = list_size (&extent_buckets[b]);
+        struct list_elem *e;
+
+        for (e = list_begin (&extent_buckets[b]);
+             e != list_end (&extent_buckets[b]); e = list_next (e))
+          {
+            struct extent *x = list_entry (e, struct extent, bucket_elem);
+            if (x->length > largest)
+              largest = x->length;
+          }
+        if (cnt > 0)
+          printf ("  %6zu extents of %zu%s sectors\n",
+                  cnt, (size_t) 1 << b,
+                  b + 1 < EXTENT_BUCKET_CNT ? "+" : " or more");
+        extent_cnt += cnt;
+      }
+  printf ("Free extents: %zu, largest %zu sectors\n", extent_cnt, largest);
+  lock_release (&free_map_lock);
+}
+
+/* pseudOS: Rebuilds the free extent index from the bitmap. */
+static void
+extents_build (void)
+{
+  size_t size = bitmap_size (free_map);
+  size_t start = 0;
+
+  extents_clear ();
+  extents_ok = true;
+  while (start < size)
+    {
+      size_t end;
+
+      start = bitmap_scan (free_map, start, 1, false);
+      if (start == BITMAP_ERROR)
+        break;
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = size;
+      if (!extent_add (start, end - start))
+        {
+          extents_clear ();
+          return;
+        }
+      start = end;
+    }
+}
+
+/* pseudOS: Empties the free extent index and falls back to
+   scanning the bitmap until it is rebuilt. */
+static void
+extents_clear (void)
+{
+  size_t b;
+
+  for (b = 0; b < EXTENT_BUCKET_CNT; b++)
+    while (!list_empty (&extent_buckets[b]))
+      {
+        struct extent *e = list_entry (list_front (&extent_buckets[b]),
+                                       struct extent, bucket_elem);
+        extent_remove (e);
+        free (e);
+      }
+  extents_ok = false;
+}
+
+/* pseudOS: Adds the free extent of LENGTH sectors at START to the
+   index.  Returns false if memory allocation fails. */
+static bool
+extent_add (block_sector_t start, size_t length)
+{
+  struct extent *e = malloc (sizeof *e);
+  if (e == NULL)
+    return false;
+
+  e->start = start;
+  e->length = length;
+  list_push_back (&extent_buckets[extent_bucket (length)], &e->bucket_elem);
+  hash_insert (&extents_by_start, &e->start_elem);
+  hash_insert (&extents_by_end, &e->end_elem);
+  return true;
+}
+
+/* pseudOS: Removes E from the index without freeing it. */
+static void
+extent_remove (struct extent *e)
+{
+  list_remove (&e->bucket_elem);
+  hash_delete (&extents_by_start, &e->start_elem);
+  hash_delete (&extents_by_end, &e->end_elem);
+}
+
+/* pseudOS: Returns the extent in EXTENTS, which is either
+   extents_by_start or extents_by_end, whose key is SECTOR, or a
+   null pointer if there is none. */
+static struct extent *
+extent_find (struct hash *extents, block_sector_t sector)
+{
+  struct extent key;
+  struct hash_elem *e;
+
+  if (extents == &extents_by_start)
+    {
+      key.start = sector;
+      e = hash_find (extents, &key.start_elem);
+      return e != NULL ? hash_entry (e, struct extent, start_elem) : NULL;
+    }
+  else
+    {
+      key.start = sector;
+      key.length = 0;
+      e = hash_find (extents, &key.end_elem);
+      return e != NULL ? hash_entry (e, struct extent, end_elem) : NULL;
+    }
+}
+
+/* pseudOS: Returns the size bucket for extents of LENGTH
+   sectors. */
+static size_t
+extent_bucket (size_t length)
+{
+  size_t b = 0;
+
+  while (length > 1 && b + 1 < EXTENT_BUCKET_CNT)
+    {
+      length >>= 1;
+      b++;
+    }
+  return b;
+}
+
+/* pseudOS: Hash and comparison functions for extents_by_start and
+   extents_by_end. */
+static unsigned
+extent_start_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct extent, start_elem)->start);
+}
+
+static bool
+extent_start_less (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED)
+{
+  return (hash_entry (a, struct extent, start_elem)->start
+          < hash_entry (b, struct extent, start_elem)->start);
+}
+
+static unsigned
+extent_end_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct extent *e = hash_entry (e_, struct extent, end_elem);
+  return hash_int (e->start + e->length);
+}
+
+static bool
+extent_end_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                 void *aux UNUSED)
+{
+  const struct extent *a = hash_entry (a_, struct extent, end_elem);
+  const struct extent *b = hash_entry (b_, struct extent, end_elem);
+  return a->start + a->length < b->start + b->length;
 }
@@ -7,6 +7,8 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -27,6 +29,31 @@ fsutil_ls (char **argv UNUSED)
   printf ("End of listing.\n");
 }
 
+/* pseudOS: Prints free space fragmentation and the number of
+   extents each file in the root directory is stored in. */
+void
+fsutil_frag (char **argv UNUSED)
+{
+  struct dir *dir;
+  char name[NAME_MAX + 1];
+
+  free_map_print_stats ();
+  printf ("Extents of files in the root directory:\n");
+  dir = dir_open_root ();
+  if (dir == NULL)
+    PANIC ("root dir open failed");
+  while (dir_readdir (dir, name))
+    {
+      struct file *file = filesys_open (name);
+      if (file == NULL)
+        continue;
+      printf ("%6zu %s\n", inode_extent_cnt (file_get_inode (file)), name);
+      file_close (file);
+    }
+  dir_close (dir);
+  printf ("End of listing.\n");
+}
+
 /* Prints the contents of file ARGV[1] to the system console as
    hex and ASCII. */
 void
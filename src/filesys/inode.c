@@ -1,76 +1,194 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* pseudOS: Number of sector slots in the on-disk inode and in an
+   indirect block. */
+#define DIRECT_CNT 123
+#define INDIRECT_CNT (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   pseudOS: Data sectors are found through DIRECT_CNT direct
+   slots, one indirect block of INDIRECT_CNT slots and one doubly
+   indirect block of INDIRECT_CNT indirect blocks.  A slot that
+   holds 0 has no sector allocated yet (sector 0 always holds the
+   free map inode), which reads as zeros. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+    block_sector_t indirect;            /* Indirect block. */
+    block_sector_t doubly_indirect;     /* Doubly indirect block. */
+    uint32_t is_dir;                    /* pseudOS: Nonzero for directories. */
   };
 
-/* Returns the number of sectors to allocate for an inode SIZE
-   bytes long. */
-static inline size_t
-bytes_to_sectors (off_t size)
-{
-  return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
-}
-
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
+    struct lock lock;                   /* pseudOS: Protects next two. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct lock grow_lock;              /* pseudOS: Serializes growth. */
+    block_sector_t last_alloc;          /* pseudOS: Last sector allocated. */
     struct inode_disk data;             /* Inode content. */
   };
 
+static bool allocate_sector (struct inode *, block_sector_t *);
+static block_sector_t inode_slot (struct inode *, block_sector_t *,
+                                  bool create);
+static block_sector_t index_slot (struct inode *, block_sector_t block,
+                                  size_t idx, bool create);
+static void release_sectors (block_sector_t, int depth);
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   pseudOS: If CREATE is true, missing data and index sectors are
+   allocated on the way.  Returns 0 if no sector is allocated for
+   POS, if allocation fails or if POS is beyond the largest
+   possible file. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos, bool create) 
 {
+  size_t idx;
+  block_sector_t block;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
-    return -1;
+  ASSERT (pos >= 0);
+
+  idx = pos / BLOCK_SECTOR_SIZE;
+  if (idx < DIRECT_CNT)
+    return inode_slot (inode, &inode->data.direct[idx], create);
+
+  idx -= DIRECT_CNT;
+  if (idx < INDIRECT_CNT)
+    {
+      block = inode_slot (inode, &inode->data.indirect, create);
+      return block != 0 ? index_slot (inode, block, idx, create) : 0;
+    }
+
+  idx -= INDIRECT_CNT;
+  if (idx < INDIRECT_CNT * INDIRECT_CNT)
+    {
+      block = inode_slot (inode, &inode->data.doubly_indirect, create);
+      if (block != 0)
+        block = index_slot (inode, block, idx / INDIRECT_CNT, create);
+      return (block != 0
+              ? index_slot (inode, block, idx % INDIRECT_CNT, create) : 0);
+    }
+
+  return 0;
+}
+
+/* pseudOS: Allocates a sector for INODE, fills it with zeros and
+   stores it into *SECTORP.  Prefers the sector right after the
+   one INODE got last, so that files written front to back end up
+   contiguous on disk.  Returns false if the disk is full. */
+static bool
+allocate_sector (struct inode *inode, block_sector_t *sectorp)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (!free_map_allocate_near (1, inode->last_alloc + 1, sectorp))
+    return false;
+  inode->last_alloc = *sectorp;
+  cache_write (*sectorp, zeros);
+  return true;
+}
+
+/* pseudOS: Returns the sector in SLOT, a member of INODE's on-disk
+   inode.  If the slot is empty and CREATE is true, allocates a
+   sector for it and writes back the inode. */
+static block_sector_t
+inode_slot (struct inode *inode, block_sector_t *slot, bool create)
+{
+  if (*slot == 0 && create && allocate_sector (inode, slot))
+    cache_write (inode->sector, &inode->data);
+  return *slot;
+}
+
+/* pseudOS: Returns the sector in slot IDX of the index block
+   BLOCK, allocating it first if it is empty and CREATE is
+   true. */
+static block_sector_t
+index_slot (struct inode *inode, block_sector_t block, size_t idx,
+            bool create)
+{
+  block_sector_t sector;
+  off_t ofs = idx * sizeof sector;
+
+  cache_read_at (block, &sector, sizeof sector, ofs);
+  if (sector == 0 && create && allocate_sector (inode, &sector))
+    cache_write_at (block, &sector, sizeof sector, ofs);
+  return sector;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* pseudOS: Releases SECTOR and, if DEPTH is positive, every sector
+   reachable from it as an index block DEPTH levels deep. */
+static void
+release_sectors (block_sector_t sector, int depth)
+{
+  if (sector == 0)
+    return;
+
+  if (depth > 0)
+    {
+      block_sector_t *slots = malloc (BLOCK_SECTOR_SIZE);
+      size_t i;
+
+      if (slots == NULL)
+        PANIC ("out of memory releasing index block %"PRDSNu, sector);
+      cache_read (sector, slots);
+      for (i = 0; i < INDIRECT_CNT; i++)
+        release_sectors (slots[i], depth - 1);
+      free (slots);
+    }
+  free_map_release (sector, 1);
+}
+
+/* Open inodes, so that opening a single inode twice returns the
+   same `struct inode'.
+   pseudOS: Hashed by sector.  open_inodes_lock protects the table
+   and the open_cnt of every inode in it. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+static struct inode *inode_lookup (block_sector_t);
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  pseudOS: IS_DIR marks the inode as a directory.
+   No data sectors are allocated here; they are allocated when
+   they are first written.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
+   Returns false if memory allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -84,22 +202,11 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
+      disk_inode->is_dir = is_dir;
+      cache_write (sector, disk_inode);
+      success = true; 
       free (disk_inode);
     }
   return success;
@@ -111,33 +218,45 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
   struct inode *inode;
+  struct hash_elem *e;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  lock_acquire (&open_inodes_lock);
+  inode = inode_lookup (sector);
+  if (inode != NULL)
+    inode->open_cnt++;
+  lock_release (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.
+     pseudOS: The inode is read without holding open_inodes_lock,
+     so another thread may open the same sector meanwhile.  In
+     that case, whoever inserts first wins. */
   inode->sector = sector;
   inode->open_cnt = 1;
+  lock_init (&inode->lock);
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  lock_init (&inode->grow_lock);
+  inode->last_alloc = sector;
+  cache_read (inode->sector, &inode->data);
+
+  lock_acquire (&open_inodes_lock);
+  e = hash_insert (&open_inodes, &inode->elem);
+  if (e != NULL)
+    {
+      free (inode);
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+    }
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +265,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,22 +286,31 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          size_t i;
+
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          for (i = 0; i < DIRECT_CNT; i++)
+            release_sectors (inode->data.direct[i], 0);
+          release_sectors (inode->data.indirect, 1);
+          release_sectors (inode->data.doubly_indirect, 2);
         }
 
       free (inode); 
@@ -191,7 +323,9 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  lock_acquire (&inode->lock);
   inode->removed = true;
+  lock_release (&inode->lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -202,12 +336,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -220,110 +353,117 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* pseudOS: Copy the chunk out of the buffer cache.
+         Sectors that were never written read as zeros. */
+      sector_idx = byte_to_sector (inode, offset, false);
+      if (sector_idx != 0)
+        cache_read_at (sector_idx, buffer + bytes_read, chunk_size,
+                       sector_ofs);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk is full or an error occurs.
+   pseudOS: Writing past end of file extends the inode. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  off_t pos;
 
-  if (inode->deny_write_cnt)
+  if (inode->deny_write_cnt || size <= 0)
     return 0;
 
+  lock_acquire (&inode->grow_lock);
+
+  /* pseudOS: Allocate all sectors before copying any data, so
+     that the free map, whose own allocations change its content,
+     is written consistently.  On a full disk, only write the
+     part that could be allocated. */
+  for (pos = offset - offset % BLOCK_SECTOR_SIZE; pos < offset + size;
+       pos += BLOCK_SECTOR_SIZE)
+    if (byte_to_sector (inode, pos, true) == 0)
+      {
+        size = pos > offset ? pos - offset : 0;
+        break;
+      }
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset, false);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left in sector. */
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+      int chunk_size = size < sector_left ? size : sector_left;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /* pseudOS: Copy the chunk into the buffer cache, which
+         reads in the rest of the sector first if needed. */
+      cache_write_at (sector_idx, buffer + bytes_written, chunk_size,
+                      sector_ofs);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
+  /* pseudOS: Extend the file if we wrote past its end.  OFFSET
+     is now just past the last byte written, and a write that
+     could not allocate any sector leaves the length alone. */
+  if (bytes_written > 0 && offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      cache_write (inode->sector, &inode->data);
+    }
+
+  lock_release (&inode->grow_lock);
   return bytes_written;
 }
 
+/* pseudOS: Asks the buffer cache to read ahead the sectors that
+   hold the SIZE bytes of INODE starting at OFFSET, stopping at
+   end of file. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size)
+{
+  off_t end = offset + size;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  offset = offset / BLOCK_SECTOR_SIZE * BLOCK_SECTOR_SIZE;
+  for (; offset < end; offset += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, offset, false);
+      if (sector != 0)
+        cache_read_ahead (sector);
+    }
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +472,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +485,70 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* pseudOS: Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->data.is_dir != 0;
+}
+
+/* pseudOS: Returns the number of openers of INODE. */
+int
+inode_open_cnt (const struct inode *inode)
+{
+  int open_cnt;
+
+  lock_acquire (&open_inodes_lock);
+  open_cnt = inode->open_cnt;
+  lock_release (&open_inodes_lock);
+  return open_cnt;
+}
+
+/* pseudOS: Returns the number of runs of consecutive sectors that
+   hold INODE's data, not counting holes.  A file stored in one
+   piece has 1 extent. */
+size_t
+inode_extent_cnt (struct inode *inode)
+{
+  block_sector_t prev = 0;
+  size_t extent_cnt = 0;
+  off_t pos;
+
+  for (pos = 0; pos < inode_length (inode); pos += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, pos, false);
+      if (sector != 0 && (prev == 0 || sector != prev + 1))
+        extent_cnt++;
+      prev = sector;
+    }
+  return extent_cnt;
+}
+
+/* pseudOS: Returns the open inode for SECTOR, or a null pointer if
+   it is not open.  open_inodes_lock must be held. */
+static struct inode *
+inode_lookup (block_sector_t sector)
+{
+  struct inode key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  return e != NULL ? hash_entry (e, struct inode, elem) : NULL;
+}
+
+/* pseudOS: Hash and comparison functions for open_inodes. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
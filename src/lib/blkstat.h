@@ -0,0 +1,45 @@
+#ifndef __LIB_BLKSTAT_H
+#define __LIB_BLKSTAT_H
+
+#include <stdint.h>
+
+/* pseudOS: I/O statistics for a block device, as returned by the
+   blkstat system call and printed at shutdown.
+
+   Histogram bucket I counts events that took between 2**I and
+   2**(I+1) - 1 CPU cycles, as measured by the time-stamp
+   counter.  Bucket 0 also counts events of 0 cycles and the last
+   bucket everything longer. */
+#define BLKSTAT_BUCKETS 40
+
+/* Block device roles, numbered as in enum block_type. */
+#define BLKSTAT_KERNEL 0                /* Pintos OS kernel. */
+#define BLKSTAT_FILESYS 1               /* File system. */
+#define BLKSTAT_SCRATCH 2               /* Scratch. */
+#define BLKSTAT_SWAP 3                  /* Swap. */
+
+struct blkstat
+  {
+    uint64_t read_cnt;                  /* Sectors read. */
+    uint64_t write_cnt;                 /* Sectors written. */
+    uint64_t read_req_cnt;              /* Read requests. */
+    uint64_t write_req_cnt;             /* Write requests. */
+
+    /* Time from submitting a request until it completed, for
+       reads and writes. */
+    uint64_t read_latency[BLKSTAT_BUCKETS];
+    uint64_t write_latency[BLKSTAT_BUCKETS];
+
+    /* Time the device took to raise each interrupt after the
+       driver issued the command or took the previous interrupt.
+       For a partition, this is the histogram of its disk. */
+    uint64_t service[BLKSTAT_BUCKETS];
+
+    /* Requests queued or being transferred on the device's disk,
+       sampled each time a request is submitted. */
+    uint64_t depth_samples;             /* Number of samples. */
+    uint64_t depth_sum;                 /* Sum of all samples. */
+    uint64_t depth_max;                 /* Largest sample. */
+  };
+
+#endif /* lib/blkstat.h */
@@ -28,7 +28,14 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* pseudOS. */
+    SYS_BLKSTAT,                /* Returns I/O statistics for a device. */
+    SYS_FORK,                   /* Duplicates the current process. */
+    SYS_MADVISE,                /* Gives advice about the use of memory. */
+    SYS_MLOCK,                  /* Locks pages into memory. */
+    SYS_MUNLOCK                 /* Unlocks pages locked by mlock. */
   };
 
 #endif /* lib/syscall-nr.h */
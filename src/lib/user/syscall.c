@@ -182,3 +182,33 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+blkstat (int role, struct blkstat *stats)
+{
+  return syscall2 (SYS_BLKSTAT, role, stats);
+}
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+bool
+madvise (void *addr, size_t length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+bool
+mlock (const void *addr, size_t length)
+{
+  return syscall2 (SYS_MLOCK, addr, length);
+}
+
+bool
+munlock (const void *addr, size_t length)
+{
+  return syscall2 (SYS_MUNLOCK, addr, length);
+}
@@ -2,7 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <debug.h>
+#include <blkstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -38,6 +40,13 @@ void close (int fd);
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
 
+/* pseudOS: Advice for madvise(). */
+#define MADV_NORMAL 0           /* No advice, the default. */
+#define MADV_SEQUENTIAL 1       /* Pages will be accessed in order. */
+#define MADV_RANDOM 2           /* Pages will be accessed in random order. */
+#define MADV_WILLNEED 3         /* Pages will be accessed soon. */
+#define MADV_DONTNEED 4         /* Pages will not be accessed soon. */
+
 /* Project 4 only. */
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
@@ -45,4 +54,11 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* pseudOS. */
+bool blkstat (int role, struct blkstat *);
+pid_t fork (void);
+bool madvise (void *addr, size_t length, int advice);
+bool mlock (const void *addr, size_t length);
+bool munlock (const void *addr, size_t length);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,14 @@
+/* Passes a bad pointer to the blkstat system call, which must
+   cause the process to be terminated with exit code -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  msg ("blkstat(0x20101234): %d",
+       blkstat (BLKSTAT_FILESYS, (struct blkstat *) 0x20101234));
+  fail ("should have exited with -1");
+}
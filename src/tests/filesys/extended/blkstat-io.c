@@ -0,0 +1,47 @@
+/* Checks that blkstat() fails for roles that are out of range,
+   and that the counters of the file system device grow when a
+   file is written and read back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Twice as many sectors as the buffer cache holds, so that
+   writing the file and reading it back has to go to disk. */
+#define FILE_SIZE (128 * 512)
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  struct blkstat before, after;
+  int fd;
+
+  CHECK (!blkstat (-1, &before), "blkstat(-1) (must fail)");
+  CHECK (!blkstat (BLKSTAT_SWAP + 1, &before), "blkstat(%d) (must fail)",
+         BLKSTAT_SWAP + 1);
+  CHECK (blkstat (BLKSTAT_FILESYS, &before), "blkstat(BLKSTAT_FILESYS)");
+
+  memset (buf, 0x5a, sizeof buf);
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"data\"");
+  seek (fd, 0);
+  CHECK (read (fd, buf, sizeof buf) == sizeof buf, "read \"data\"");
+  msg ("close \"data\"");
+  close (fd);
+  CHECK (remove ("data"), "remove \"data\"");
+
+  CHECK (blkstat (BLKSTAT_FILESYS, &after), "blkstat(BLKSTAT_FILESYS)");
+  if (after.write_cnt <= before.write_cnt
+      || after.write_req_cnt <= before.write_req_cnt)
+    fail ("write counters did not grow");
+  if (after.read_cnt <= before.read_cnt
+      || after.read_req_cnt <= before.read_req_cnt)
+    fail ("read counters did not grow");
+  if (after.depth_samples <= before.depth_samples)
+    fail ("queue depth was not sampled");
+  msg ("counters grew");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(blkstat-io) begin
+(blkstat-io) blkstat(-1) (must fail)
+(blkstat-io) blkstat(4) (must fail)
+(blkstat-io) blkstat(BLKSTAT_FILESYS)
+(blkstat-io) create "data"
+(blkstat-io) open "data"
+(blkstat-io) write "data"
+(blkstat-io) read "data"
+(blkstat-io) close "data"
+(blkstat-io) remove "data"
+(blkstat-io) blkstat(BLKSTAT_FILESYS)
+(blkstat-io) counters grew
+(blkstat-io) end
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Looks up names that do not exist, so that the directory cache
+   remembers them as missing, then creates and removes them and
+   makes sure that each lookup sees the change.  Does this in the
+   root directory and again through a subdirectory. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+check_name (const char *name)
+{
+  int fd;
+
+  CHECK (open (name) == -1, "open \"%s\" (must fail)", name);
+  CHECK (create (name, 0), "create \"%s\"", name);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  msg ("close \"%s\"", name);
+  close (fd);
+  CHECK (remove (name), "remove \"%s\"", name);
+  CHECK (open (name) == -1, "open \"%s\" (must fail)", name);
+}
+
+void
+test_main (void) 
+{
+  check_name ("xyzzy");
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (!chdir ("a/b"), "chdir \"a/b\" (must fail)");
+  CHECK (mkdir ("a/b"), "mkdir \"a/b\"");
+  CHECK (chdir ("a/b"), "chdir \"a/b\"");
+  check_name ("xyzzy");
+  CHECK (chdir ("/"), "chdir \"/\"");
+  CHECK (remove ("a/b"), "rmdir \"a/b\"");
+  CHECK (!chdir ("a/b"), "chdir \"a/b\" (must fail)");
+}
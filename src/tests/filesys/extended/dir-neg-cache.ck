@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-neg-cache) begin
+(dir-neg-cache) open "xyzzy" (must fail)
+(dir-neg-cache) create "xyzzy"
+(dir-neg-cache) open "xyzzy"
+(dir-neg-cache) close "xyzzy"
+(dir-neg-cache) remove "xyzzy"
+(dir-neg-cache) open "xyzzy" (must fail)
+(dir-neg-cache) mkdir "a"
+(dir-neg-cache) chdir "a/b" (must fail)
+(dir-neg-cache) mkdir "a/b"
+(dir-neg-cache) chdir "a/b"
+(dir-neg-cache) open "xyzzy" (must fail)
+(dir-neg-cache) create "xyzzy"
+(dir-neg-cache) open "xyzzy"
+(dir-neg-cache) close "xyzzy"
+(dir-neg-cache) remove "xyzzy"
+(dir-neg-cache) open "xyzzy" (must fail)
+(dir-neg-cache) chdir "/"
+(dir-neg-cache) rmdir "a/b"
+(dir-neg-cache) chdir "a/b" (must fail)
+(dir-neg-cache) end
+dir-neg-cache: exit(0)
+EOF
+pass;
@@ -0,0 +1,7 @@
+/* Grows a file from 0 bytes to 50,000 bytes, 1,234 bytes at a
+   time.  The kernel's frag action then checks that the file's
+   sectors were allocated one after another, in a single
+   extent. */
+
+#define TEST_SIZE 50000
+#include "tests/filesys/extended/grow-seq.inc"
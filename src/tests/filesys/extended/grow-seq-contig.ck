@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-seq-contig) begin
+(grow-seq-contig) create "testme"
+(grow-seq-contig) open "testme"
+(grow-seq-contig) writing "testme"
+(grow-seq-contig) close "testme"
+(grow-seq-contig) open "testme" for verification
+(grow-seq-contig) verified contents of "testme"
+(grow-seq-contig) close "testme"
+(grow-seq-contig) end
+EOF
+
+my ($listing) = grep (/^\s*\d+ testme$/, read_text_file ("$test.output"));
+fail "\"testme\" missing from the frag listing\n" if !defined $listing;
+my ($extent_cnt) = $listing =~ /^\s*(\d+)/;
+fail "\"testme\" is stored in $extent_cnt extents, not 1\n"
+  if $extent_cnt != 1;
+pass;
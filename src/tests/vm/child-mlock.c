@@ -0,0 +1,27 @@
+/* Child process of mlock-exit.
+   Locks 64 pages, unlocks half of them, and exits with the other
+   half still locked. */
+
+#include <round.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-mlock";
+
+#define PAGE_SIZE 4096
+#define LOCKED_MAX 64           /* Pages a process may lock. */
+
+static char buf[(LOCKED_MAX + 1) * PAGE_SIZE];
+
+int
+main (void)
+{
+  char *pages = (char *) ROUND_UP ((uintptr_t) buf, PAGE_SIZE);
+
+  if (!mlock (pages, LOCKED_MAX * PAGE_SIZE))
+    return 1;
+  if (!munlock (pages, LOCKED_MAX / 2 * PAGE_SIZE))
+    return 2;
+  return 0x42;
+}
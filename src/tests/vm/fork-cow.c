@@ -0,0 +1,49 @@
+/* Forks a child and checks that writes after the fork to data,
+   bss and stack pages are private.  The parent writes first and
+   then lets the child go on, which must still see the values
+   from before the fork.  The child's own writes must not be
+   seen by the parent. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile int data = 1;
+static volatile int bss;
+
+void
+test_main (void)
+{
+  volatile int stack = 3;
+  pid_t pid;
+  int fd;
+
+  bss = 2;
+  CHECK (create ("go", 0), "create \"go\"");
+  CHECK ((fd = open ("go")) > 1, "open \"go\"");
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* Wait until the parent has written its values. */
+      while (filesize (fd) == 0)
+        continue;
+      if (data != 1 || bss != 2 || stack != 3)
+        exit (1);
+      data = 10;
+      bss = 20;
+      stack = 30;
+      if (data != 10 || bss != 20 || stack != 30)
+        exit (2);
+      exit (0);
+    }
+
+  CHECK (pid > 0, "fork");
+  data = 100;
+  bss = 200;
+  stack = 300;
+  CHECK (write (fd, "", 1) == 1, "write \"go\"");
+  CHECK (wait (pid) == 0, "wait for child");
+  CHECK (data == 100 && bss == 200 && stack == 300, "check parent's values");
+  close (fd);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-cow) begin
+(fork-cow) create "go"
+(fork-cow) open "go"
+(fork-cow) fork
+(fork-cow) write "go"
+(fork-cow) wait for child
+(fork-cow) check parent's values
+(fork-cow) end
+EOF
+pass;
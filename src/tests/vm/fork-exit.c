@@ -0,0 +1,29 @@
+/* Forks a child that exits right away, and then writes to the
+   data, bss and stack pages it shared with the child, which are
+   now only the parent's. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile int data = 1;
+static volatile int bss;
+
+void
+test_main (void)
+{
+  volatile int stack = 3;
+  pid_t pid;
+
+  bss = 2;
+  pid = fork ();
+  if (pid == 0)
+    exit (0);
+
+  CHECK (pid > 0, "fork");
+  CHECK (wait (pid) == 0, "wait for child");
+  data++;
+  bss++;
+  stack++;
+  CHECK (data == 2 && bss == 3 && stack == 4, "check values");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-exit) begin
+(fork-exit) fork
+(fork-exit) wait for child
+(fork-exit) check values
+(fork-exit) end
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Runs the work of child-linear in 4 forked children at once.
+   The parent writes the first half of the buffer before forking,
+   so that the children start out sharing those frames, and all
+   of them together need more memory than fits in RAM. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+#define SIZE (1024 * 1024)
+
+static char buf[SIZE];
+
+/* Encrypts the zeros in buf with KEY, then decrypts them, and
+   exits with 0x42 if the zeros are back. */
+static void
+child (const char *key)
+{
+  struct arc4 arc4;
+  size_t i;
+
+  arc4_init (&arc4, key, strlen (key));
+  arc4_crypt (&arc4, buf, SIZE);
+  arc4_init (&arc4, key, strlen (key));
+  arc4_crypt (&arc4, buf, SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != '\0')
+      exit (1);
+  exit (0x42);
+}
+
+void
+test_main (void)
+{
+  static const char *keys[CHILD_CNT] = {"child 0", "child 1", "child 2",
+                                        "child 3"};
+  pid_t children[CHILD_CNT];
+  size_t i;
+
+  memset (buf, 0, SIZE / 2);
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      children[i] = fork ();
+      if (children[i] == 0)
+        child (keys[i]);
+      CHECK (children[i] > 0, "fork child %zu", i);
+    }
+
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (wait (children[i]) == 0x42, "wait for child %zu", i);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-parallel) begin
+(fork-parallel) fork child 0
+(fork-parallel) fork child 1
+(fork-parallel) fork child 2
+(fork-parallel) fork child 3
+(fork-parallel) wait for child 0
+(fork-parallel) wait for child 1
+(fork-parallel) wait for child 2
+(fork-parallel) wait for child 3
+(fork-parallel) end
+EOF
+pass;
@@ -0,0 +1,19 @@
+/* Forks a child.  fork() must return 0 in the child, which
+   exits with a code of its own, and the child's pid in the
+   parent, which can then wait for it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t pid = fork ();
+  if (pid == 0)
+    exit (81);
+
+  CHECK (pid > 0, "fork");
+  CHECK (wait (pid) == 81, "wait for child");
+  CHECK (wait (pid) == -1, "wait for child again (must fail)");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-return) begin
+(fork-return) fork
+(fork-return) wait for child
+(fork-return) wait for child again (must fail)
+(fork-return) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Fills 2 MB of memory, more than fits in RAM, so that its first
+   pages are swapped out, and forks.  The parent then overwrites
+   the first page.  The child must still see the old contents of
+   the first and the last page, and its write to the first page
+   must not be seen by the parent. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+#define PAGE_SIZE 4096
+
+static char buf[SIZE];
+
+/* Returns true if the LEN bytes at OFS in buf hold the pattern
+   that test_main() initializes it with. */
+static bool
+has_pattern (size_t ofs, size_t len)
+{
+  size_t i;
+
+  for (i = ofs; i < ofs + len; i++)
+    if (buf[i] != (char) (i % 251))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+  size_t i;
+  int fd;
+
+  msg ("initialize");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+  CHECK (create ("go", 0), "create \"go\"");
+  CHECK ((fd = open ("go")) > 1, "open \"go\"");
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* Wait until the parent has written the first page. */
+      while (filesize (fd) == 0)
+        continue;
+      if (!has_pattern (0, PAGE_SIZE) || !has_pattern (SIZE - PAGE_SIZE, PAGE_SIZE))
+        exit (1);
+      memset (buf, 0x11, PAGE_SIZE);
+      exit (0);
+    }
+
+  CHECK (pid > 0, "fork");
+  memset (buf, 0xff, PAGE_SIZE);
+  CHECK (write (fd, "", 1) == 1, "write \"go\"");
+  CHECK (wait (pid) == 0, "wait for child");
+
+  msg ("check");
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (buf[i] != (char) 0xff)
+      fail ("byte %zu != 0xff", i);
+  if (!has_pattern (PAGE_SIZE, SIZE - PAGE_SIZE))
+    fail ("pattern changed after the first page");
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-swap) begin
+(fork-swap) initialize
+(fork-swap) create "go"
+(fork-swap) open "go"
+(fork-swap) fork
+(fork-swap) write "go"
+(fork-swap) wait for child
+(fork-swap) check
+(fork-swap) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Passes advice that does not exist to madvise(), and kernel
+   addresses to madvise(), mlock() and munlock(), which must all
+   return false without killing the process.  Every valid advice
+   for a mapped range must succeed. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char buf[2 * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  void *kernel = (void *) 0xc0000000;
+  void *below_kernel = (void *) (0xc0000000 - PAGE_SIZE);
+
+  CHECK (!madvise (buf, sizeof buf, -1), "madvise(-1) (must fail)");
+  CHECK (!madvise (buf, sizeof buf, MADV_DONTNEED + 1),
+         "madvise(MADV_DONTNEED + 1) (must fail)");
+  CHECK (!madvise (kernel, PAGE_SIZE, MADV_NORMAL),
+         "madvise kernel address (must fail)");
+  CHECK (!madvise (below_kernel, 2 * PAGE_SIZE, MADV_NORMAL),
+         "madvise range into the kernel (must fail)");
+  CHECK (!mlock (kernel, PAGE_SIZE), "mlock kernel address (must fail)");
+  CHECK (!munlock (kernel, PAGE_SIZE), "munlock kernel address (must fail)");
+
+  CHECK (madvise (buf, sizeof buf, MADV_SEQUENTIAL), "madvise(MADV_SEQUENTIAL)");
+  CHECK (madvise (buf, sizeof buf, MADV_RANDOM), "madvise(MADV_RANDOM)");
+  CHECK (madvise (buf, sizeof buf, MADV_WILLNEED), "madvise(MADV_WILLNEED)");
+  CHECK (madvise (buf, sizeof buf, MADV_DONTNEED), "madvise(MADV_DONTNEED)");
+  CHECK (madvise (buf, sizeof buf, MADV_NORMAL), "madvise(MADV_NORMAL)");
+}
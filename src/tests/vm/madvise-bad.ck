@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-bad) begin
+(madvise-bad) madvise(-1) (must fail)
+(madvise-bad) madvise(MADV_DONTNEED + 1) (must fail)
+(madvise-bad) madvise kernel address (must fail)
+(madvise-bad) madvise range into the kernel (must fail)
+(madvise-bad) mlock kernel address (must fail)
+(madvise-bad) munlock kernel address (must fail)
+(madvise-bad) madvise(MADV_SEQUENTIAL)
+(madvise-bad) madvise(MADV_RANDOM)
+(madvise-bad) madvise(MADV_WILLNEED)
+(madvise-bad) madvise(MADV_DONTNEED)
+(madvise-bad) madvise(MADV_NORMAL)
+(madvise-bad) end
+EOF
+pass;
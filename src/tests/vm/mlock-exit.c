@@ -0,0 +1,31 @@
+/* Runs child-mlock, which exits with pages locked, more times
+   than all of their pages could be locked at once.  This only
+   works if exiting unlocks them.  Then locks 64 pages itself. */
+
+#include <round.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 8
+#define PAGE_SIZE 4096
+#define LOCKED_MAX 64           /* Pages a process may lock. */
+
+static char buf[(LOCKED_MAX + 1) * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  char *pages = (char *) ROUND_UP ((uintptr_t) buf, PAGE_SIZE);
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t child;
+      CHECK ((child = exec ("child-mlock")) != -1, "exec \"child-mlock\"");
+      CHECK (wait (child) == 0x42, "wait for child %d", i);
+    }
+  CHECK (mlock (pages, LOCKED_MAX * PAGE_SIZE), "mlock 64 pages");
+  CHECK (munlock (pages, LOCKED_MAX * PAGE_SIZE), "munlock 64 pages");
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-exit) begin
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 0
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 1
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 2
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 3
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 4
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 5
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 6
+(mlock-exit) exec "child-mlock"
+(mlock-exit) wait for child 7
+(mlock-exit) mlock 64 pages
+(mlock-exit) munlock 64 pages
+(mlock-exit) end
+EOF
+pass;
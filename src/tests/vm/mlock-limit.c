@@ -0,0 +1,30 @@
+/* Checks that a process can lock at most 64 pages, counting
+   pages that it locks again only once. */
+
+#include <round.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LOCKED_MAX 64           /* Pages a process may lock. */
+
+static char buf[(LOCKED_MAX + 2) * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  char *pages = (char *) ROUND_UP ((uintptr_t) buf, PAGE_SIZE);
+  char *extra = pages + LOCKED_MAX * PAGE_SIZE;
+
+  CHECK (mlock (pages, LOCKED_MAX * PAGE_SIZE), "mlock 64 pages");
+  CHECK (!mlock (extra, PAGE_SIZE), "mlock 65th page (must fail)");
+  CHECK (mlock (pages, LOCKED_MAX * PAGE_SIZE), "mlock 64 pages again");
+  CHECK (munlock (pages, PAGE_SIZE), "munlock first page");
+  CHECK (mlock (extra, PAGE_SIZE), "mlock 65th page");
+  CHECK (munlock (pages, (LOCKED_MAX + 1) * PAGE_SIZE), "munlock 65 pages");
+  CHECK (!mlock (pages, (LOCKED_MAX + 1) * PAGE_SIZE),
+         "mlock 65 pages (must fail)");
+  CHECK (mlock (extra, PAGE_SIZE), "mlock 65th page again");
+}
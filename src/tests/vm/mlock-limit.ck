@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-limit) begin
+(mlock-limit) mlock 64 pages
+(mlock-limit) mlock 65th page (must fail)
+(mlock-limit) mlock 64 pages again
+(mlock-limit) munlock first page
+(mlock-limit) mlock 65th page
+(mlock-limit) munlock 65 pages
+(mlock-limit) mlock 65 pages (must fail)
+(mlock-limit) mlock 65th page again
+(mlock-limit) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Locks 16 pages holding a pattern, then sweeps through 2 MB of
+   memory, more than fits in RAM, twice.  The locked pages must
+   hold the pattern afterward. */
+
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LOCKED_CNT 16
+#define SIZE (2 * 1024 * 1024)
+
+static char locked_buf[(LOCKED_CNT + 1) * PAGE_SIZE];
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  char *pages = (char *) ROUND_UP ((uintptr_t) locked_buf, PAGE_SIZE);
+  struct arc4 arc4;
+  size_t i;
+
+  for (i = 0; i < LOCKED_CNT * PAGE_SIZE; i++)
+    pages[i] = i % 251;
+  CHECK (mlock (pages, LOCKED_CNT * PAGE_SIZE), "mlock %d pages", LOCKED_CNT);
+
+  msg ("sweep");
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != '\0')
+      fail ("byte %zu != 0", i);
+
+  msg ("check locked pages");
+  for (i = 0; i < LOCKED_CNT * PAGE_SIZE; i++)
+    if (pages[i] != (char) (i % 251))
+      fail ("locked byte %zu changed", i);
+  CHECK (munlock (pages, LOCKED_CNT * PAGE_SIZE), "munlock %d pages",
+         LOCKED_CNT);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-sweep) begin
+(mlock-sweep) mlock 16 pages
+(mlock-sweep) sweep
+(mlock-sweep) check locked pages
+(mlock-sweep) munlock 16 pages
+(mlock-sweep) end
+EOF
+pass;
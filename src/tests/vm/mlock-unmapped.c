@@ -0,0 +1,17 @@
+/* Tries to lock pages that are not mapped, which must fail, and
+   then a range that starts in mapped memory and runs past it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+void
+test_main (void)
+{
+  CHECK (!mlock ((void *) 0x10000000, PAGE_SIZE),
+         "mlock unmapped page (must fail)");
+  CHECK (!mlock ((void *) test_main, 0x10000000),
+         "mlock past the end of the code (must fail)");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-unmapped) begin
+(mlock-unmapped) mlock unmapped page (must fail)
+(mlock-unmapped) mlock past the end of the code (must fail)
+(mlock-unmapped) end
+EOF
+pass;
@@ -25,6 +25,8 @@
 #include "vm/frame.h" /* pseudOS */
 #include "vm/page.h" /* pseudOS */
 #include "vm/swap.h" /* pseudOS */
+#include "vm/zswap.h" /* pseudOS */
+#include "vm/region.h" /* pseudOS */
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,6 +39,7 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -102,6 +105,8 @@ main (void)
   malloc_init ();
   paging_init ();
   frame_table_init ();  /* pseudOS */
+  spt_module_init ();  /* pseudOS */
+  region_init ();  /* pseudOS */
   
   /* Segmentation. */
 #ifdef USERPROG
@@ -251,9 +256,24 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-flush"))
+        cache_flush_interval = atoi (value);
+      else if (!strcmp (name, "-dirty"))
+        cache_dirty_ratio = atoi (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-faultaround"))
+        spt_fault_around = atoi (value);
+      else if (!strcmp (name, "-zswap"))
+        zswap_arena_pages = atoi (value);
+      else if (!strcmp (name, "-swapra"))
+        swap_readahead = atoi (value);
+      else if (!strcmp (name, "-evict"))
+        {
+          if (value == NULL || !frame_set_policy (value))
+            PANIC ("unknown eviction policy `%s'", value);
+        }
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -317,6 +337,7 @@ run_actions (char **argv)
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
+      {"frag", 1, fsutil_frag},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
 #endif
@@ -365,6 +386,7 @@ usage (void)
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
+          "  frag               Print free space and file fragmentation.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
@@ -377,8 +399,14 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -flush=TICKS       Write back dirty sectors every TICKS ticks.\n"
+          "  -dirty=PERCENT     Write back once PERCENT of cache is dirty.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -faultaround=PAGES Load up to PAGES of a file per page fault.\n"
+          "  -zswap=PAGES       Keep up to PAGES of compressed swap in RAM.\n"
+          "  -swapra=PAGES      Read PAGES ahead on swap-in, 0 to disable.\n"
+          "  -evict=POLICY      Evict pages by POLICY, clock or eclock.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
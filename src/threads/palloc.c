@@ -148,6 +148,15 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* pseudOS: Stores the address of the first page of the user
+   pool in *BASE and the number of pages in it in *PAGE_CNT. */
+void
+palloc_get_user_pool (void **base, size_t *page_cnt)
+{
+  *base = user_pool.base;
+  *page_cnt = bitmap_size (user_pool.used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
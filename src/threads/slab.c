@@ -0,0 +1,230 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* pseudOS: A slab allocator, for objects that are allocated and
+   freed often, such as the entries of page tables.
+
+   Each kind of object has a cache of its own.  A cache takes
+   pages, called "slabs", from the page allocator and divides
+   them into objects of exactly its object size, so that, unlike
+   with malloc(), no memory is lost to rounding up to a power of
+   2.  Each slab has a header with a list of its free objects.
+
+   Objects are allocated from partially used slabs first, so that
+   the cache stays dense, and a slab all of whose objects are free
+   is kept for reuse.  A cache keeps at most SLAB_EMPTY_MAX such
+   slabs, and gives any others back to the page allocator.
+
+   A slab_free() has to name the cache the object was allocated
+   from.  The header of its slab is found by rounding the object's
+   address down to the page. */
+
+/* pseudOS: Empty slabs a cache keeps. */
+#define SLAB_EMPTY_MAX 1
+
+/* pseudOS: Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* pseudOS: Slab header, at the start of the slab's page. */
+struct slab 
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    struct free_obj *free;      /* Free objects. */
+    size_t free_cnt;            /* Number of free objects. */
+  };
+
+/* pseudOS: Free object. */
+struct free_obj
+  {
+    struct free_obj *next;      /* Next free object in the slab. */
+  };
+
+/* pseudOS: All caches, for statistics. */
+static struct list caches = LIST_INITIALIZER (caches);
+
+static struct slab *obj_to_slab (void *);
+static struct slab *slab_create (struct slab_cache *);
+
+/* pseudOS: Initializes CACHE for objects of SIZE bytes, named
+   NAME.  If CTOR is not null, it is called on each object before
+   slab_alloc() returns it.  The cache does not allocate any
+   memory until its first object is allocated, so this may be
+   called before the page allocator is initialized. */
+void
+slab_cache_init (struct slab_cache *cache, const char *name, size_t size,
+                 slab_ctor_func *ctor) 
+{
+  enum intr_level old_level;
+
+  cache->name = name;
+  cache->obj_size = ROUND_UP (size < sizeof (struct free_obj)
+                              ? sizeof (struct free_obj) : size,
+                              sizeof (uint64_t));
+  cache->objs_per_slab = ((PGSIZE - ROUND_UP (sizeof (struct slab),
+                                              sizeof (uint64_t)))
+                          / cache->obj_size);
+  ASSERT (cache->objs_per_slab > 0);
+  cache->ctor = ctor;
+  lock_init (&cache->lock);
+  list_init (&cache->partial);
+  list_init (&cache->full);
+  list_init (&cache->empty);
+  cache->alloc_cnt = 0;
+  cache->used_cnt = 0;
+  cache->peak_cnt = 0;
+  cache->slab_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&caches, &cache->elem);
+  intr_set_level (old_level);
+}
+
+/* pseudOS: Obtains and returns a new object from CACHE.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *cache) 
+{
+  struct slab *s;
+  struct free_obj *obj;
+
+  lock_acquire (&cache->lock);
+  if (!list_empty (&cache->partial))
+    s = list_entry (list_front (&cache->partial), struct slab, elem);
+  else if (!list_empty (&cache->empty))
+    {
+      s = list_entry (list_pop_front (&cache->empty), struct slab, elem);
+      list_push_front (&cache->partial, &s->elem);
+    }
+  else 
+    {
+      s = slab_create (cache);
+      if (s == NULL) 
+        {
+          lock_release (&cache->lock);
+          return NULL;
+        }
+      list_push_front (&cache->partial, &s->elem);
+    }
+
+  obj = s->free;
+  s->free = obj->next;
+  if (--s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_back (&cache->full, &s->elem);
+    }
+
+  cache->alloc_cnt++;
+  if (++cache->used_cnt > cache->peak_cnt)
+    cache->peak_cnt = cache->used_cnt;
+  lock_release (&cache->lock);
+
+  if (cache->ctor != NULL)
+    cache->ctor (obj);
+  return obj;
+}
+
+/* pseudOS: Frees OBJ, which must have been allocated from
+   CACHE.  A null pointer is ignored. */
+void
+slab_free (struct slab_cache *cache, void *obj_) 
+{
+  struct free_obj *obj = obj_;
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (obj);
+  ASSERT (s->cache == cache);
+
+  lock_acquire (&cache->lock);
+  obj->next = s->free;
+  s->free = obj;
+  cache->used_cnt--;
+  if (s->free_cnt++ == 0) 
+    {
+      /* Was full, now partially used. */
+      list_remove (&s->elem);
+      list_push_front (&cache->partial, &s->elem);
+    }
+  if (s->free_cnt == cache->objs_per_slab) 
+    {
+      list_remove (&s->elem);
+      if (list_size (&cache->empty) < SLAB_EMPTY_MAX)
+        list_push_back (&cache->empty, &s->elem);
+      else 
+        {
+          cache->slab_cnt--;
+          s->magic = 0;
+          palloc_free_page (s);
+        }
+    }
+  lock_release (&cache->lock);
+}
+
+/* pseudOS: Prints statistics of the caches that were used. */
+void
+slab_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+      if (c->alloc_cnt == 0)
+        continue;
+      printf ("slab: %s: %llu allocated, %zu in use (peak %zu), "
+              "%zu slabs of %zu\n",
+              c->name, c->alloc_cnt, c->used_cnt, c->peak_cnt,
+              c->slab_cnt, c->objs_per_slab);
+    }
+}
+
+/* pseudOS: Returns the slab that OBJ is in. */
+static struct slab *
+obj_to_slab (void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  return s;
+}
+
+/* pseudOS: Allocates a new slab for CACHE, with all of its
+   objects free, and returns it, or a null pointer if memory is
+   not available.  Must be called with CACHE's lock held. */
+static struct slab *
+slab_create (struct slab_cache *cache) 
+{
+  struct slab *s;
+  uint8_t *objs;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->free = NULL;
+  s->free_cnt = cache->objs_per_slab;
+  objs = (uint8_t *) s + ROUND_UP (sizeof *s, sizeof (uint64_t));
+  for (i = cache->objs_per_slab; i-- > 0; ) 
+    {
+      struct free_obj *obj = (struct free_obj *) (objs + i * cache->obj_size);
+      obj->next = s->free;
+      s->free = obj;
+    }
+  cache->slab_cnt++;
+  return s;
+}
@@ -0,0 +1,38 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* pseudOS: Object constructor, called on each object that
+   slab_alloc() returns. */
+typedef void slab_ctor_func (void *obj);
+
+/* pseudOS: A cache of objects of one size. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of each object in bytes. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    slab_ctor_func *ctor;       /* Constructor, or null. */
+    struct lock lock;           /* Protects the members below. */
+    struct list partial;        /* Slabs with used and free objects. */
+    struct list full;           /* Slabs without free objects. */
+    struct list empty;          /* Slabs without used objects. */
+    struct list_elem elem;      /* Element in the list of all caches. */
+
+    /* Statistics. */
+    unsigned long long alloc_cnt; /* Objects allocated. */
+    size_t used_cnt;            /* Objects in use. */
+    size_t peak_cnt;            /* Most objects in use at once. */
+    size_t slab_cnt;            /* Slabs, i.e. pages, in the cache. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name, size_t size,
+                      slab_ctor_func *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
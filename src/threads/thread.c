@@ -14,7 +14,7 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/fixed-point.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "vm/page.h"
 
 #include "../devices/timer.h"
@@ -47,6 +47,9 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* pseudOS: Cache of child process information. */
+static struct slab_cache child_cache;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -102,6 +105,8 @@ thread_init (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
+  slab_cache_init (&child_cache, "child_process",
+                   sizeof (struct child_process), NULL);
   list_init (&ready_list);
   list_init (&all_list);
   
@@ -248,10 +253,11 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
-  struct child_process *cp = malloc(sizeof(struct child_process));
+  struct child_process *cp = slab_alloc (&child_cache);
   cp->pid = t->tid;
   cp->parent = thread_current ();
   cp->exit_status = DEFAULT_EXIT_STATUS;
+  cp->exited = false;
   t->child_info = cp;
 
   t->child_info->parent_is_waiting = false;
@@ -266,7 +272,9 @@ thread_create (const char *name, int priority,
   t->spt = malloc(sizeof(struct hash));
   spt_init(t->spt);
   list_init(&t->mapped_files);
+  list_init(&t->regions);
   t->next_mapid = INIT_MAPID; 
+  t->locked_cnt = 0;
 #endif
 
   intr_set_level (old_level);
@@ -363,8 +371,36 @@ thread_exit (void)
   ASSERT (!intr_context ());
   
   struct thread *t = thread_current ();
-  sema_up (&t->child_info->alive);        /* pseudOS */
-  sema_up (&t->child_info->init);        /* pseudOS */
+  struct list done;
+  enum intr_level old_level;
+
+  /* pseudOS: A child's record is freed by whichever of the two
+     is done with it last: the parent once it has waited for the
+     child or exited, the child once it has exited. */
+  list_init (&done);
+  old_level = intr_disable ();
+  if (t->child_info != NULL)
+    {
+      t->child_info->exited = true;
+      if (t->child_info->parent == NULL)
+        list_push_back (&done, &t->child_info->childelem);
+      sema_up (&t->child_info->alive);
+      sema_up (&t->child_info->init);
+      t->child_info = NULL;
+    }
+  while (!list_empty (&t->childs))
+    {
+      struct child_process *cp = list_entry (list_pop_front (&t->childs),
+                                             struct child_process, childelem);
+      if (cp->exited)
+        list_push_back (&done, &cp->childelem);
+      else
+        cp->parent = NULL;
+    }
+  intr_set_level (old_level);
+  while (!list_empty (&done))
+    slab_free (&child_cache, list_entry (list_pop_front (&done),
+                                         struct child_process, childelem));
 
 #ifdef USERPROG
   process_exit ();
@@ -615,6 +651,7 @@ init_thread (struct thread *t, const char *name, int priority)
   int i;
   for(i = 0; i < FD_ARR_DEFAULT_LENGTH; i++)
     t->fds[i] = NULL;
+  t->cwd = NULL;
 
   list_init (&t->childs);
   t->child_info = NULL;
@@ -966,4 +1003,15 @@ thread_mlfqs_update_properties (void)
           return cp;
     }
     return NULL;
- }
\ No newline at end of file
+ }
+
+/* pseudOS: Removes CP, an exited child of the running thread
+   that has been waited for, from its children and frees it. */
+void
+thread_free_child (struct child_process *cp)
+{
+  ASSERT (cp->exited && cp->parent == thread_current ());
+
+  list_remove (&cp->childelem);
+  slab_free (&child_cache, cp);
+}
\ No newline at end of file
@@ -121,7 +121,9 @@ struct thread
     /* pseudOS: Project 3 */
     struct hash* spt;                       /* pseudOS: Supplemental page table. */
     struct list mapped_files;               /* pseudOS: This list holds pointers of all memory mapped files. */ 
+    struct list regions;                    /* pseudOS: Regions of the address space, sorted by address. */
     int next_mapid;
+    size_t locked_cnt;                      /* pseudOS: Pages locked with mlock(). */
 #endif
 
     /* Owned by thread.c. */
@@ -137,6 +139,9 @@ struct thread
 
     /* pseudOS: Project 2 */
     struct file* fds[FD_ARR_DEFAULT_LENGTH]; /* pseudOS: This array holds pointers of all open files. */
+
+    /* pseudOS: Project 4 */
+    struct dir *cwd;                         /* pseudOS: Working directory, null for the root. */
   };
 
 /* pseudOS: Project 3 - memory mapped file */
@@ -146,7 +151,7 @@ struct mapped_file_t
   int fd;
   int mapid;
   void *addr;
-  struct list spt_entries;
+  struct region *region;  /* pseudOS: Region of the mapping. */
 };
 
 /* If false (default), use round-robin scheduler.
@@ -203,5 +208,6 @@ void thread_mlfqs_update_properties (void);
 
 /* pseudOS */
 struct child_process *thread_get_child (int pid);
+void thread_free_child (struct child_process *);
 
 #endif /* threads/thread.h */
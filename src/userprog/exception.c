@@ -151,16 +151,20 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   // user = (f->error_code & PF_U) != 0;
 
-  if(not_present && is_user_vaddr(fault_addr))
+  /* pseudOS: a write to a present page is a write to the shared zero page
+     or to a copy-on-write frame shared after fork(), unless the page is
+     read-only. */
+  if((not_present || write) && is_user_vaddr(fault_addr))
   {
-    struct spt_entry_t *e = spt_lookup (thread_current ()->spt, fault_addr);
-    if(e && ((write && e->writable) || !write)  && spt_load_page (e))
+    struct spt_entry_t *e = spt_find (fault_addr);
+    if(e && ((write && e->writable) || !write)  && spt_fault (e, write))
       return;
-    else if(fault_addr >= f->esp - 32)
+    else if(not_present && fault_addr >= f->esp - 32)
     {
       //pseudOS: if a pagefault occurs between esp and (esp - 32) the stack has to grow
-      stack_growth (fault_addr);
-      return;
+      e = stack_growth (fault_addr);
+      if(e && spt_fault (e, write))
+        return;
     }
   }
 
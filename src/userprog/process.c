@@ -20,8 +20,11 @@
 #include "threads/vaddr.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/region.h"
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
+static bool fork_files (struct thread *parent);
 static bool load (const char *cmdline, void (**eip) (void), void **esp, char **argv);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
               uint32_t read_bytes, uint32_t zero_bytes, bool writable);
@@ -61,6 +64,97 @@ process_execute (const char *file_name)
   return tid;
 }
 
+/* pseudOS: Starts a new thread running a copy of the current
+   process, which made the system call in IF_.  The child returns 0
+   from it.  Returns the new process's thread id, or TID_ERROR if
+   the thread cannot be created.  As with process_execute(), the
+   caller has to wait for the child's init semaphore before it
+   returns, since the child copies the caller's address space. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct intr_frame *if_copy = malloc (sizeof *if_copy);
+  tid_t tid;
+
+  if (if_copy == NULL)
+    return TID_ERROR;
+  *if_copy = *if_;
+
+  tid = thread_create (thread_current ()->name, PRI_DEFAULT, start_fork,
+                       if_copy);
+  if (tid == TID_ERROR)
+    free (if_copy);
+  return tid;
+}
+
+/* pseudOS: A thread function that copies its parent's address
+   space, open files and working directory, and returns to user
+   mode where the parent made the fork system call.  Pages are
+   shared copy-on-write, see spt_fork(). */
+static void
+start_fork (void *if_)
+{
+  struct thread *t = thread_current ();
+  struct thread *parent = t->child_info->parent;
+  struct intr_frame if_copy = *(struct intr_frame *) if_;
+  bool success = false;
+
+  free (if_);
+  if_copy.eax = 0;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL)
+    {
+      process_activate ();
+      success = fork_files (parent) && spt_fork (parent, t->executable);
+    }
+  t->child_info->load_success = success;
+
+  if (!success)
+    thread_exit ();
+
+  sema_up (&t->child_info->init);
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_copy) : "memory");
+  NOT_REACHED ();
+}
+
+/* pseudOS: Reopens the executable, open files and working
+   directory of PARENT for the current process.  Each file keeps
+   its position.  Returns false if memory runs out. */
+static bool
+fork_files (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  bool success = true;
+  int i;
+
+  lock_acquire (&syscall_lock);
+  if (parent->cwd != NULL)
+    {
+      t->cwd = dir_reopen (parent->cwd);
+      success = t->cwd != NULL;
+    }
+  if (parent->executable != NULL)
+    {
+      t->executable = file_reopen (parent->executable);
+      if (t->executable != NULL)
+        file_deny_write (t->executable);
+      else
+        success = false;
+    }
+  for (i = 0; i < FD_ARR_DEFAULT_LENGTH; i++)
+    if (parent->fds[i] != NULL)
+      {
+        t->fds[i] = file_reopen (parent->fds[i]);
+        if (t->fds[i] != NULL)
+          file_seek (t->fds[i], file_tell (parent->fds[i]));
+        else
+          success = false;
+      }
+  lock_release (&syscall_lock);
+  return success;
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
@@ -71,6 +165,16 @@ start_process (void *file_name_)
   struct intr_frame if_;
   bool success;
 
+  /* pseudOS: Inherit the parent's working directory.  The parent
+     waits for us to finish loading, so its cwd stays open. */
+  struct thread *parent = thread_current ()->child_info->parent;
+  if (parent->cwd != NULL)
+    {
+      lock_acquire (&syscall_lock);
+      thread_current ()->cwd = dir_reopen (parent->cwd);
+      lock_release (&syscall_lock);
+    }
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
@@ -125,21 +229,33 @@ process_exit (void)
    entries used by the mappings. */
   munmap (MUNMAP_ALL);
 
-  if(cur->executable != NULL)
-  {  
-    lock_acquire (&syscall_lock);
-    file_close (cur->executable); 
-    lock_release (&syscall_lock); 
-  }
-  
   /* pseudOS: close all open files */
   int i;
   for(i = 0; i < FD_ARR_DEFAULT_LENGTH; i++)
     close(i);
+
+  /* pseudOS: close the working directory */
+  if (cur->cwd != NULL)
+  {
+    lock_acquire (&syscall_lock);
+    dir_close (cur->cwd);
+    cur->cwd = NULL;
+    lock_release (&syscall_lock);
+  }
  
   /* pseudOS: Frees all resources of the supplemental page table.
      Frees also all occupied frame table entries. */
   spt_free(cur->spt);
+  region_free_all (&cur->regions);
+
+  /* pseudOS: close the executable only now, its pages may be in shared
+     frames that are found by its inode. */
+  if(cur->executable != NULL)
+  {  
+    lock_acquire (&syscall_lock);
+    file_close (cur->executable); 
+    lock_release (&syscall_lock); 
+  }
   
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -437,27 +553,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
-  while (read_bytes > 0 || zero_bytes > 0) 
-  {
-    /* Calculate how to fill this page.
-       We will read PAGE_READ_BYTES bytes from FILE
-       and zero the final PAGE_ZERO_BYTES bytes. */
-    size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-    size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-    bool pinned = writable ? SPT_UNPINNED : SPT_PINNED;
-
-    if (! spt_insert (thread_current ()->spt, file, ofs, 
-          upage, page_read_bytes, page_zero_bytes, writable, pinned, SPT_ENTRY_TYPE_SWAP) )
-        return false; 
-
-    read_bytes -= page_read_bytes;
-    zero_bytes -= page_zero_bytes;
-    ofs += page_read_bytes;
-    upage += PGSIZE;
-  }
-  return true;
+  /* pseudOS: the pages get their supplemental page table entries
+     when they are first used, see spt_find().  Read-only pages are
+     not pinned either: they are clean, so evicting them needs no
+     write-back, and they are read from FILE again on the next fault. */
+  return region_add (&thread_current ()->regions, upage,
+                     (read_bytes + zero_bytes) / PGSIZE, file, ofs, read_bytes,
+                     writable, SPT_UNPINNED, SPT_ENTRY_TYPE_SWAP) != NULL;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -465,8 +567,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
-  /* pseudOS: create first stack page at initial stack address PHYS_BASE - PG_SIZE */
-  if(stack_growth (((uint8_t *) PHYS_BASE) - PGSIZE))
+  /* pseudOS: create first stack page at initial stack address PHYS_BASE - PG_SIZE,
+     and load it right away, since the arguments are written to it next. */
+  if(spt_load_page (stack_growth (((uint8_t *) PHYS_BASE) - PGSIZE)))
   {
     *esp = PHYS_BASE;
     return true;
@@ -536,29 +639,20 @@ init_stack (const char *file_name, void **esp, char **argv)
 
 /* pseudOS: As long as the stack is not bigger than MAX_STACK_SIZE , 
  * the stack grows by adding a new page of the user space to it.
+ * The page is zero-fill, so no frame is allocated until it is used.
+ * Returns the new page, or NULL on failure.
 */
-bool
+struct spt_entry_t *
 stack_growth (void *vaddr) 
 {
   if((PHYS_BASE - pg_round_down(vaddr)) >= MAX_STACK_SIZE)
     exit(-1);
 
-  bool success = false;
   bool writable = true;
 
   uint8_t *upage = pg_round_down(vaddr);
-  struct spt_entry_t *spte = spt_insert (thread_current ()->spt, NULL, 0, upage, 
-                                          PGSIZE, 0, writable, SPT_PINNED, SPT_ENTRY_TYPE_SWAP); 
-  success = frame_table_insert (spte);
-  
-  if(!success)
-  {
-    spt_remove (thread_current ()->spt, upage);
-  }
-  
-  if(intr_context())
-    spte->pinned = SPT_UNPINNED; 
-  return success;
+  return spt_insert (thread_current ()->spt, NULL, 0, upage, 
+                     0, PGSIZE, writable, SPT_UNPINNED, SPT_ENTRY_TYPE_SWAP); 
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
@@ -2,6 +2,7 @@
 #define USERPROG_PROCESS_H
 
 #include "threads/thread.h"
+#include "threads/interrupt.h"
 #include "userprog/syscall.h"
 #include "filesys/file.h"
 
@@ -14,18 +15,20 @@ struct child_process
     struct list_elem childelem; /* pseudOS: List element. */
     pid_t pid;                  /* pseudOS: ID of the process. */
     int exit_status;            /* pseudOS: Status which is passed to the system-call exit. */
-    struct thread *parent;      /* pseudOS: Reference to the process parent. */
+    struct thread *parent;      /* pseudOS: Reference to the process parent, null once it has exited. */
     struct semaphore alive;     /* pseudOS: This semaphore is down till the thread dies. */
     struct semaphore init;      /* pseudOS: This semaphore goes up if the initialization is done. */
     bool load_success;          /* pseudOS: Indicates if loading the executable was sucessful. */
     bool parent_is_waiting;     /* pseudOS: Indicates if the parent is already waiting for this child. */
+    bool exited;                /* pseudOS: Indicates if the child has exited. */
   };
 
 tid_t process_execute (const char *file_name);
+tid_t process_fork (const struct intr_frame *if_);   /* pseudOS */
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
-bool stack_growth (void *vaddr);    /* pseudOS: Adds a page to the stack */
+struct spt_entry_t *stack_growth (void *vaddr);    /* pseudOS: Adds a page to the stack */
 
 bool install_page (void *upage, void *kpage, bool writable);
 
@@ -3,12 +3,17 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "devices/block.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
 #include "vm/page.h"
+#include "vm/region.h"
 #include "pagedir.h"
 #include "process.h"
 #include <stdio.h>
@@ -16,9 +21,12 @@
 #include <list.h>
 #include <string.h>
 #include <hash.h>
+#include <round.h>
 
 #define OFFSET_ARG 4							/* pseudOS: Offest of arguments on the stack. */
 
+static struct slab_cache mfile_cache;			/* pseudOS: Cache of mapped files. */
+
 static void syscall_handler (struct intr_frame *);
 static bool is_valid_fd(int fd);				/* pseudOS: Checks if the given file-descriptor is valid. */
 static void check_args (struct intr_frame *f, unsigned nr_of_args);
@@ -31,11 +39,13 @@ static bool is_mapped_file (int fd);
 static void set_spte_pin (void * addr, bool pinned);
 static void set_args_pin (struct intr_frame *f, unsigned nr_of_args, bool pinned);
 static void set_buffer_pin (void * buffer, unsigned size, bool pinned);
+static pid_t fork_process (struct intr_frame *f);
 
 void
 syscall_init (void) 
 {
 	lock_init (&syscall_lock);
+	slab_cache_init (&mfile_cache, "mapped_file", sizeof (struct mapped_file_t), NULL);
 	intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -194,6 +204,116 @@ syscall_handler (struct intr_frame *f)
 			set_args_pin (f, 1, SPT_UNPINNED);
 			break;
 
+		case SYS_MADVISE:
+			check_args (f, 3);
+			set_args_pin (f, 3, SPT_PINNED);
+			f->eax = madvise (
+				*(void **)(f->esp + OFFSET_ARG), 
+				*(size_t *)(f->esp + OFFSET_ARG * 2), 
+				*(int *)(f->esp + OFFSET_ARG * 3) );
+			set_args_pin (f, 3, SPT_UNPINNED);
+			break;
+
+		case SYS_MLOCK:
+			check_args (f, 2);
+			set_args_pin (f, 2, SPT_PINNED);
+			f->eax = mlock (
+				*(void **)(f->esp + OFFSET_ARG), 
+				*(size_t *)(f->esp + OFFSET_ARG * 2) );
+			set_args_pin (f, 2, SPT_UNPINNED);
+			break;
+
+		case SYS_MUNLOCK:
+			check_args (f, 2);
+			set_args_pin (f, 2, SPT_PINNED);
+			f->eax = munlock (
+				*(void **)(f->esp + OFFSET_ARG), 
+				*(size_t *)(f->esp + OFFSET_ARG * 2) );
+			set_args_pin (f, 2, SPT_UNPINNED);
+			break;
+
+		case SYS_CHDIR:
+			check_args (f, 1);
+			check_usr_ptr (*(char **)(f->esp + OFFSET_ARG), f->esp);
+			set_args_pin (f, 1, SPT_PINNED);
+			f->eax = chdir ( *(char **)(f->esp + OFFSET_ARG) );
+			set_args_pin (f, 1, SPT_UNPINNED);
+			break;
+
+		case SYS_MKDIR:
+			check_args (f, 1);
+			check_usr_ptr (*(char **)(f->esp + OFFSET_ARG), f->esp);
+			set_args_pin (f, 1, SPT_PINNED);
+			f->eax = mkdir ( *(char **)(f->esp + OFFSET_ARG) );
+			set_args_pin (f, 1, SPT_UNPINNED);
+			break;
+
+		case SYS_READDIR:
+			check_args (f, 2);
+			check_buffer (
+				*(char **)(f->esp + OFFSET_ARG * 2),
+				READDIR_MAX_LEN + 1,
+				f->esp);
+
+			set_args_pin (f, 2, SPT_PINNED);
+			set_buffer_pin (
+				*(char **)(f->esp + OFFSET_ARG * 2),
+				READDIR_MAX_LEN + 1,
+				SPT_PINNED);
+
+			f->eax = readdir (
+				*(int *)(f->esp + OFFSET_ARG),
+				*(char **)(f->esp + OFFSET_ARG * 2) );
+
+			set_buffer_pin (
+				*(char **)(f->esp + OFFSET_ARG * 2),
+				READDIR_MAX_LEN + 1,
+				SPT_UNPINNED);
+			set_args_pin (f, 2, SPT_UNPINNED);
+			break;
+
+		case SYS_ISDIR:
+			check_args (f, 1);
+			set_args_pin (f, 1, SPT_PINNED);
+			f->eax = isdir ( *(int *)(f->esp + OFFSET_ARG) );
+			set_args_pin (f, 1, SPT_UNPINNED);
+			break;
+
+		case SYS_INUMBER:
+			check_args (f, 1);
+			set_args_pin (f, 1, SPT_PINNED);
+			f->eax = inumber ( *(int *)(f->esp + OFFSET_ARG) );
+			set_args_pin (f, 1, SPT_UNPINNED);
+			break;
+
+		case SYS_BLKSTAT:
+			check_args (f, 2);
+			check_buffer (
+				*(struct blkstat **)(f->esp + OFFSET_ARG * 2),
+				sizeof (struct blkstat),
+				f->esp);
+
+			set_args_pin (f, 2, SPT_PINNED);
+			set_buffer_pin (
+				*(struct blkstat **)(f->esp + OFFSET_ARG * 2),
+				sizeof (struct blkstat),
+				SPT_PINNED);
+
+			f->eax = blkstat (
+				*(int *)(f->esp + OFFSET_ARG),
+				*(struct blkstat **)(f->esp + OFFSET_ARG * 2) );
+
+			set_buffer_pin (
+				*(struct blkstat **)(f->esp + OFFSET_ARG * 2),
+				sizeof (struct blkstat),
+				SPT_UNPINNED);
+			set_args_pin (f, 2, SPT_UNPINNED);
+			break;
+
+		case SYS_FORK:
+			f->eax = fork_process (f);
+			break;
+
 		default:
 			exit (SYSCALL_ERROR);         
 	}
@@ -239,6 +359,25 @@ exec (const char *cmd_line)
 	return SYSCALL_ERROR;
 }
 
+/*
+ * pseudOS: Creates a child process that is a copy of the current one, which made
+ * the system call in F, and returns its pid, or -1 if it cannot be created.  The
+ * child returns 0.  Its address space is shared copy-on-write.
+ */
+static pid_t
+fork_process (struct intr_frame *f)
+{
+	pid_t pid = process_fork (f);
+	if(pid == TID_ERROR)
+		return SYSCALL_ERROR;
+
+	struct child_process *cp = thread_get_child (pid);
+	sema_down (&cp->init);
+	if(cp->load_success)
+		return pid;
+	return SYSCALL_ERROR;
+}
+
 /*
  * pseudOS: Waits for a child process pid and retrieves the child's exit status.
  */
@@ -248,10 +387,13 @@ wait (pid_t pid)
  	struct child_process *cp = thread_get_child (pid);
 	if(cp != NULL && !cp->parent_is_waiting)
 	{
+		int status;
+
 		cp->parent_is_waiting = true;
 		sema_down (&cp->alive);
-		sema_up (&cp->alive);
-		return cp->exit_status;
+		status = cp->exit_status;
+		thread_free_child (cp);
+		return status;
 	}
 	return SYSCALL_ERROR;
 }
@@ -381,7 +523,8 @@ write (int fd, const void *buffer, unsigned size)
 		lock_release(&syscall_lock);
 		return size;
 	}
-	else if (fd >= FD_INIT && thread_current ()->fds[fd - FD_INIT] != NULL )
+	else if (fd >= FD_INIT && thread_current ()->fds[fd - FD_INIT] != NULL 
+		&& !inode_is_dir (file_get_inode (thread_current ()->fds[fd - FD_INIT])))
 	{
 		int r = file_write (
 			thread_current ()->fds[fd - FD_INIT],
@@ -468,34 +611,22 @@ mmap (int fd, void *addr)
 		|| ! is_valid_mapping (addr, flen))		/* pseudOS: 3. */
 		return MAP_FAILED;
 	
-	struct mapped_file_t *mfile = malloc(sizeof(struct mapped_file_t));
+	struct mapped_file_t *mfile = slab_alloc (&mfile_cache);
 	if (!mfile) return MAP_FAILED;
 	mfile->fd = fd;
 	mfile->addr = addr;
+	mfile->region = region_add (&t->regions, addr, DIV_ROUND_UP (flen, PGSIZE), 
+								f, 0, flen, true, SPT_UNPINNED, SPT_ENTRY_TYPE_MMAP);
+	if (!mfile->region)
+	{
+		slab_free (&mfile_cache, mfile);
+		return MAP_FAILED;
+	}
 	mfile->mapid = (mapid_t) t->next_mapid++;
-	list_init (&mfile->spt_entries);
 	list_push_back (&t->mapped_files, &mfile->elem);
 
-	off_t ofs = 0;
-	while(flen > 0)
-	{
-		uint32_t read_bytes = (flen > PGSIZE ) ? PGSIZE : flen ;
-		uint32_t zero_bytes = PGSIZE - read_bytes;
-
-		struct spt_entry_t *spte = spt_insert (t->spt, f, ofs, (uint8_t *)addr, 
-				read_bytes, zero_bytes, true, SPT_UNPINNED, SPT_ENTRY_TYPE_MMAP);
-		if(! spte)
-		{
-			munmap (mfile->mapid);
-			return MAP_FAILED;
-		}
-
-		list_push_back (&mfile->spt_entries, &spte->listelem);
-
-		addr += PGSIZE;
- 		flen -= read_bytes;
-		ofs  += read_bytes;
-	}
+	/* pseudOS: the pages get their supplemental page table entries when 
+	   they are first used, see spt_find(). */
 	return mfile->mapid;
 }
 
@@ -514,12 +645,14 @@ munmap (mapid_t mapping)
 		if (mapping == mfile->mapid || mapping == MUNMAP_ALL)
 		{
 			struct file *file = t->fds[mfile->fd - FD_INIT];
-			struct list_elem *mfe_next;
-			struct list_elem *mfe = list_begin (&mfile->spt_entries);
-			while (mfe != list_end (&mfile->spt_entries))
+			struct region *r = mfile->region;
+			size_t page;
+			for (page = 0; page < r->page_cnt; page++)
 			{
-				mfe_next  = list_next (mfe);
-				struct spt_entry_t *spte = list_entry (mfe, struct spt_entry_t, listelem);
+				/* pseudOS: only pages that were used have entries. */
+				struct spt_entry_t *spte = spt_lookup (t->spt, r->start + page * PGSIZE);
+				if (spte == NULL)
+					continue;
 				spte->pinned = SPT_PINNED;
 				void *kpage = pagedir_get_page (t->pagedir, spte->upage);
 
@@ -533,18 +666,149 @@ munmap (mapid_t mapping)
 				}
 				spt_remove (t->spt, spte->upage);		/* remove supplemental page table entry. */
 				spt_entry_free (&spte->hashelem, NULL);	/* free resources of entry. */
-				mfe = mfe_next;
 			}
+			region_remove (r);
 			lock_acquire (&syscall_lock);
 			close (mfile->fd);
 			lock_release (&syscall_lock);
 			list_remove (&mfile->elem);
-			free (mfile);
+			slab_free (&mfile_cache, mfile);
 		}
 		e = next;
 	} /* end iteration over mapped files */
 }
 
+/*
+ * pseudOS: Advises the kernel how the LENGTH bytes at ADDR will be used, see
+ * spt_madvise().  Returns true if successful, false if ADVICE is not valid or
+ * the range is not in user space.
+ */
+bool
+madvise (void *addr, size_t length, int advice)
+{
+	return spt_madvise (addr, length, advice);
+}
+
+/*
+ * pseudOS: Locks the pages of the LENGTH bytes at ADDR into memory.  Returns
+ * true if successful, false if a page does not exist or too many pages would
+ * be locked.
+ */
+bool
+mlock (const void *addr, size_t length)
+{
+	return spt_mlock (addr, length);
+}
+
+/*
+ * pseudOS: Unlocks the pages of the LENGTH bytes at ADDR.  Returns true if
+ * successful, false if the range is not in user space.
+ */
+bool
+munlock (const void *addr, size_t length)
+{
+	return spt_munlock (addr, length);
+}
+
+/*
+ * pseudOS: Changes the current working directory of the process to dir, which may be 
+ * relative or absolute. Returns true if successful, false on failure.
+ */
+bool 
+chdir (const char *dir)
+{
+	lock_acquire (&syscall_lock);
+	bool b = filesys_chdir (dir);
+	lock_release (&syscall_lock);
+	return b;
+}
+
+/*
+ * pseudOS: Creates the directory named dir, which may be relative or absolute. 
+ * Returns true if successful, false on failure.
+ */
+bool 
+mkdir (const char *dir)
+{
+	lock_acquire (&syscall_lock);
+	bool b = filesys_mkdir (dir);
+	lock_release (&syscall_lock);
+	return b;
+}
+
+/*
+ * pseudOS: Reads a directory entry from file descriptor fd, which must represent a directory. 
+ * If successful, stores the null-terminated file name in name and returns true. 
+ * Returns false if no entries are left. "." and ".." are never returned.
+ */
+bool 
+readdir (int fd, char name[READDIR_MAX_LEN + 1])
+{
+	if( ! is_valid_fd(fd) || thread_current ()->fds[fd - FD_INIT] == NULL )
+		return false;
+
+	lock_acquire (&syscall_lock);
+	struct file *file = thread_current ()->fds[fd - FD_INIT];
+	struct dir *dir = NULL;
+	bool b = false;
+	if (inode_is_dir (file_get_inode (file)))
+		dir = dir_open (inode_reopen (file_get_inode (file)));
+	if (dir != NULL)
+	{
+		/* pseudOS: the file position doubles as the directory position. */
+		dir_seek (dir, file_tell (file));
+		b = dir_readdir (dir, name);
+		file_seek (file, dir_tell (dir));
+		dir_close (dir);
+	}
+	lock_release (&syscall_lock);
+	return b;
+}
+
+/*
+ * pseudOS: Returns true if fd represents a directory, false if it represents an ordinary file.
+ */
+bool 
+isdir (int fd)
+{
+	if( ! is_valid_fd(fd) || thread_current ()->fds[fd - FD_INIT] == NULL )
+		exit (SYSCALL_ERROR);
+
+	return inode_is_dir (file_get_inode (thread_current ()->fds[fd - FD_INIT]));
+}
+
+/*
+ * pseudOS: Returns the inode number of the inode associated with fd, 
+ * which may represent an ordinary file or a directory.
+ */
+int 
+inumber (int fd)
+{
+	if( ! is_valid_fd(fd) || thread_current ()->fds[fd - FD_INIT] == NULL )
+		exit (SYSCALL_ERROR);
+
+	return inode_get_inumber (file_get_inode (thread_current ()->fds[fd - FD_INIT]));
+}
+
+/*
+ * pseudOS: Stores the I/O statistics of the block device that plays ROLE in STATS.
+ * Returns false if ROLE is out of range or no device plays it.
+ */
+bool
+blkstat (int role, struct blkstat *stats)
+{
+	struct blkstat snapshot;
+
+	if (role < 0 || role >= BLOCK_ROLE_CNT || block_get_role (role) == NULL)
+		return false;
+
+	/* pseudOS: a page fault while copying to the user's buffer would turn
+	   interrupts back on, so take the snapshot into kernel memory first. */
+	block_get_stats (block_get_role (role), &snapshot);
+	memcpy (stats, &snapshot, sizeof snapshot);
+	return true;
+}
+
 /*
  * pseudOS: Checks if the given file-descriptor is valid. 
  */
@@ -570,13 +834,35 @@ is_valid_mapid(mapid_t mapping)
 static bool
 is_valid_mapping (void *addr, off_t file_len)
 {
+	struct thread *t = thread_current ();
 	uint8_t *range_begin = (uint8_t*) addr;
 	uint8_t *range_end = (uint8_t*)(addr + file_len);
+	size_t page_cnt = DIV_ROUND_UP (file_len, PGSIZE);
+
+	if (!is_user_vaddr (range_end - 1) || range_end < range_begin
+		|| region_overlaps (&t->regions, addr, page_cnt))
+		return false;
+
+	/* pseudOS: pages outside of regions, those of the stack, only have
+	   supplemental page table entries.  Look at the entries or at the pages
+	   of the range, whichever are fewer. */
+	if (hash_size (t->spt) < page_cnt)
+	{
+		struct hash_iterator i;
+		hash_first (&i, t->spt);
+		while (hash_next (&i))
+		{
+			uint8_t *upage = hash_entry (hash_cur (&i), struct spt_entry_t, hashelem)->upage;
+			if (upage >= range_begin && upage < range_end)
+				return false;
+		}
+		return true;
+	}
 
 	uint8_t *tmp_addr;
 	for (tmp_addr = range_begin; tmp_addr < range_end; tmp_addr += PGSIZE)
 	{
-		if (spt_lookup (thread_current ()->spt, tmp_addr) != NULL)
+		if (spt_lookup (t->spt, tmp_addr) != NULL)
 			return false;
 	}
 	return true;
@@ -603,7 +889,7 @@ check_usr_ptr (void *vaddr, void *esp)
 	if(vaddr == NULL || !is_user_vaddr(vaddr))
 		exit (SYSCALL_ERROR);
 
-	struct spt_entry_t *e = spt_lookup (thread_current ()->spt, vaddr);
+	struct spt_entry_t *e = spt_find (vaddr);
 
 	if(e)
 	{
@@ -614,7 +900,7 @@ check_usr_ptr (void *vaddr, void *esp)
 	    // pseudOS: create a new page for the stack, if there is no entry 
 		// for vaddr in the supplemental page table and if vaddr is higher 
 		// than (esp - 32) 
-	    if(!stack_growth (vaddr))
+	    if(!spt_load_page (stack_growth (vaddr)))
 	    	exit (SYSCALL_ERROR);
 	} else 
 		exit (SYSCALL_ERROR);
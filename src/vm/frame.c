@@ -6,6 +6,7 @@
 #include "threads/loader.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
@@ -14,165 +15,1112 @@
 #include "userprog/syscall.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
-#include <list.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define FRAME_FAILED -1
 
+/* pseudOS: The pageout daemon is woken up when fewer than 1/PAGEOUT_LOW_WATER
+   of the frames are free, and writes back dirty pages until 1/PAGEOUT_CLEAN of
+   the frames hold clean pages that can be evicted without any I/O. */
+#define PAGEOUT_LOW_WATER 32
+#define PAGEOUT_CLEAN 8
+
+/* pseudOS: At most 1/LOCKED_MAX of the frames may hold pages locked with
+   mlock(). */
+#define LOCKED_MAX 2
+
 static struct lock ft_lock;
-static struct list frame_table;
+static struct condition evict_done;		/* pseudOS: Signaled when a page has been
+										   written back by eviction or by the
+										   pageout daemon. */
+
+/* pseudOS: One entry per frame of the user pool, indexed by physical frame
+   number, counted from the first frame of the pool. */
+static struct frame_table_entry_t *frame_table;
+static size_t frame_cnt;
+static uintptr_t base_pfn;
+
+/* pseudOS: Next frame the clock algorithm looks at. */
+static size_t clock_hand;
+
+/* pseudOS: A page of zeros, mapped read-only for all zero-fill pages that
+   have only been read so far.  It is not in the user pool, so it is never
+   evicted. */
+static void *zero_page;
+
+/* pseudOS: Shared frames of file pages by file page, protected by ft_lock.
+   Each holds a read-only page of an executable, mapped by every process
+   running it that has touched the page. */
+static struct hash shared_frames;
+static struct slab_cache sharer_cache;
+
+/* pseudOS: Pageout daemon state, protected by ft_lock. */
+static size_t free_cnt;					/* Frames not in use. */
+static size_t pageout_hand;				/* Next frame the daemon looks at. */
+static bool pageout_requested;			/* Daemon should run a pass. */
+static bool pageout_started;			/* Daemon thread created? */
+static struct condition pageout_wanted;	/* Signaled to wake up the daemon. */
 
-static struct frame_table_entry_t *frame_table_get_entry (void *upage);
-static void frame_table_evict_frame (void);
+/* pseudOS: Pages locked with mlock() by all processes, protected by
+   ft_lock. */
+static size_t locked_cnt;
+
+/* pseudOS: Page replacement policy, set with the -evict option. */
+enum frame_policy frame_policy = FRAME_POLICY_ECLOCK;
+
+static struct frame_table_entry_t *frame_table_get_entry (void *kpage);
+static hash_hash_func shared_hash;
+static hash_less_func shared_less;
+static struct frame_table_entry_t *shared_lookup (struct spt_entry_t *spte);
+static void share (struct frame_table_entry_t *fte, struct frame_sharer *s);
+static bool unshare (struct frame_table_entry_t *fte, struct thread *owner,
+					 struct spt_entry_t *spte);
+static void *evict_shared (struct frame_table_entry_t *fte);
+static bool frame_is_accessed (struct frame_table_entry_t *fte);
+static void frame_clear_accessed (struct frame_table_entry_t *fte);
+static bool frame_is_dirty (struct frame_table_entry_t *fte);
+static void *frame_kpage (struct frame_table_entry_t *fte);
+static void *frame_table_evict_frame (void);
+static struct frame_table_entry_t *clock_advance (void);
+static bool is_evictable (struct frame_table_entry_t *fte);
+static struct frame_table_entry_t *clock_select (void);
+static struct frame_table_entry_t *eclock_select (void);
+static void *insert (struct spt_entry_t *spte, bool may_evict);
+static void *alloc_frame (bool may_evict);
+static void free_frame (void *kpage);
+static size_t low_water (void);
+static void write_back (struct spt_entry_t *spte, struct thread *owner,
+						void *kpage, bool dirty);
+static void request_pageout (void);
+static thread_func pageout_daemon NO_RETURN;
+static void pageout_pass (void);
+static void pageout_batch (struct swap_page *batch, 
+						   struct frame_table_entry_t **ftes, size_t cnt);
 
 void
 frame_table_init (void)
 {
+	void *base;
+	size_t i;
+
 	lock_init (&ft_lock);
-	init_frame_table (&frame_table);
+	cond_init (&evict_done);
+	palloc_get_user_pool (&base, &frame_cnt);
+	base_pfn = vtop (base) >> PGBITS;
+	frame_table = calloc (frame_cnt, sizeof *frame_table);
+	if (frame_table == NULL && frame_cnt > 0)
+		PANIC ("Cannot allocate frame table!");
+	for (i = 0; i < frame_cnt; i++)
+		list_init (&frame_table[i].sharers);
+	hash_init (&shared_frames, shared_hash, shared_less, NULL);
+	slab_cache_init (&sharer_cache, "frame_sharer", sizeof (struct frame_sharer),
+					 NULL);
+	clock_hand = 0;
+	zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	free_cnt = frame_cnt;
+	pageout_hand = 0;
+	pageout_requested = false;
+	pageout_started = false;
+	cond_init (&pageout_wanted);
+	locked_cnt = 0;
 }
 
-void 
-init_frame_table(struct list *ft)
+/*
+ * pseudOS: Selects the page replacement policy called NAME, either "clock" or
+ * "eclock" (enhanced clock).  Returns false if there is no such policy.
+ */
+bool
+frame_set_policy (const char *name)
 {
-	ASSERT (ft != NULL);
-	list_init (ft);
+	if (!strcmp (name, "clock"))
+		frame_policy = FRAME_POLICY_CLOCK;
+	else if (!strcmp (name, "eclock"))
+		frame_policy = FRAME_POLICY_ECLOCK;
+	else
+		return false;
+	return true;
 }
 
 void *
 frame_table_insert (struct spt_entry_t *spte)
+{
+	return insert (spte, true);
+}
+
+/*
+ * pseudOS: Like frame_table_insert(), but returns NULL instead of evicting a
+ * page, or if it would take one of the last free frames.  For loading pages
+ * that are not needed yet.
+ */
+void *
+frame_table_try_insert (struct spt_entry_t *spte)
+{
+	return insert (spte, false);
+}
+
+/*
+ * pseudOS: Allocates a frame for SPTE, maps it, and returns it pinned.  If no
+ * frame is free, evicts a page if MAY_EVICT is true and returns NULL
+ * otherwise.
+ */
+static void *
+insert (struct spt_entry_t *spte, bool may_evict)
 {
 	if(is_kernel_vaddr (spte->upage)) 
 		return NULL;
 
+	void *kpage = alloc_frame (may_evict);
+	if (kpage == NULL)
+		return NULL;
+
 	lock_acquire (&ft_lock);
+	if (!install_page (spte->upage, kpage, spte->writable)) 
+	{
+		lock_release (&ft_lock);
+		free_frame (kpage);
+		return NULL;
+	}
 	
-	void * kpage = palloc_get_page ( PAL_USER | PAL_ZERO );
+	struct frame_table_entry_t *fte = frame_table_get_entry (kpage);
+	fte->spte = spte;
+	fte->owner = thread_current ();
+	
+	lock_release (&ft_lock);
+	return kpage;
+}
 
+/*
+ * pseudOS: Returns a zeroed frame that is pinned and not mapped yet.  If no
+ * frame is free, evicts a page if MAY_EVICT is true and returns NULL
+ * otherwise, as it does if the frame would be one of the last free ones.
+ */
+static void *
+alloc_frame (bool may_evict)
+{
+	if (!may_evict)
+	{
+		lock_acquire (&ft_lock);
+		bool low = free_cnt <= low_water ();
+		lock_release (&ft_lock);
+		if (low)
+			return NULL;
+	}
+
+	/* pseudOS: eviction does its write-back without holding ft_lock, so that
+	   other processes can fault in pages meanwhile. */
+	void * kpage = palloc_get_page ( PAL_USER | PAL_ZERO );
+	bool fresh = kpage != NULL;
 	if(!kpage)
 	{
-		frame_table_evict_frame ();
-		kpage = palloc_get_page ( PAL_USER | PAL_ZERO );
-		if(!kpage)
-		{	
-			PANIC ("Unable to palloc page!");
-		}
+		if (!may_evict)
+			return NULL;
+		kpage = frame_table_evict_frame ();
 	}
 
-	if (!install_page (spte->upage, kpage, spte->writable)) 
+	lock_acquire (&ft_lock);
+	if (fresh)
+		free_cnt--;
+	request_pageout ();
+	frame_table_get_entry (kpage)->pinned = true;
+	lock_release (&ft_lock);
+	return kpage;
+}
+
+/*
+ * pseudOS: Frees KPAGE, a frame returned by alloc_frame() that is not mapped.
+ */
+static void
+free_frame (void *kpage)
+{
+	lock_acquire (&ft_lock);
+	frame_table_get_entry (kpage)->pinned = false;
+	free_cnt++;
+	lock_release (&ft_lock);
+	palloc_free_page (kpage);
+}
+
+/*
+ * pseudOS: Makes the frame KPAGE, returned pinned by frame_table_insert(),
+ * evictable, once its page has been filled in.  A read-only file page becomes
+ * a shared frame, unless its file page is in one already, so that other
+ * processes can map it with frame_table_share().
+ */
+void
+frame_table_unpin (void *kpage)
+{
+	/* pseudOS: the frame is ours while it is pinned. */
+	struct frame_table_entry_t *fte = frame_table_get_entry (kpage);
+	struct frame_sharer *s = NULL;
+	if (fte->spte != NULL && spt_is_shareable (fte->spte))
+		s = slab_alloc (&sharer_cache);
+
+	lock_acquire (&ft_lock);
+	fte->pinned = false;
+	if (s != NULL && list_empty (&fte->sharers)
+		&& shared_lookup (fte->spte) == NULL)
+	{
+		fte->inode = file_get_inode (fte->spte->file);
+		fte->ofs = fte->spte->ofs;
+		fte->read_bytes = fte->spte->read_bytes;
+		hash_insert (&shared_frames, &fte->hashelem);
+		s->owner = fte->owner;
+		s->spte = fte->spte;
+		share (fte, s);
+		s = NULL;
+	}
+	lock_release (&ft_lock);
+	slab_free (&sharer_cache, s);
+}
+
+/*
+ * pseudOS: Returns true if there are free frames for pages that are not
+ * needed yet, see frame_table_try_insert().
+ */
+bool
+frame_table_has_free (void)
+{
+	lock_acquire (&ft_lock);
+	bool has_free = free_cnt > low_water ();
+	lock_release (&ft_lock);
+	return has_free;
+}
+
+/*
+ * pseudOS: Reserves room for CNT more pages locked with mlock().  Returns false
+ * if that would leave too few frames for the other pages.
+ */
+bool
+frame_table_reserve_locked (size_t cnt)
+{
+	lock_acquire (&ft_lock);
+	bool success = locked_cnt + cnt <= frame_cnt / LOCKED_MAX;
+	if (success)
+		locked_cnt += cnt;
+	lock_release (&ft_lock);
+	return success;
+}
+
+/*
+ * pseudOS: Gives back room reserved with frame_table_reserve_locked() for CNT
+ * pages.
+ */
+void
+frame_table_release_locked (size_t cnt)
+{
+	lock_acquire (&ft_lock);
+	ASSERT (locked_cnt >= cnt);
+	locked_cnt -= cnt;
+	lock_release (&ft_lock);
+}
+
+/*
+ * pseudOS: Maps the shared frame of the file page of SPTE, a read-only page of
+ * the current process that is not resident, at SPTE.  Returns false if the page
+ * cannot be shared or is in no shared frame.
+ */
+bool
+frame_table_share (struct spt_entry_t *spte)
+{
+	if (!spt_is_shareable (spte))
+		return false;
+	struct frame_sharer *s = slab_alloc (&sharer_cache);
+	if (s == NULL)
+		return false;
+
+	lock_acquire (&ft_lock);
+	struct frame_table_entry_t *fte = shared_lookup (spte);
+	if (fte == NULL || !install_page (spte->upage, frame_kpage (fte), false))
 	{
-		palloc_free_page (kpage);
 		lock_release (&ft_lock);
-		return NULL;
+		slab_free (&sharer_cache, s);
+		return false;
 	}
-	
-	struct frame_table_entry_t *new_fte = malloc(sizeof(struct frame_table_entry_t));
-	new_fte->spte = spte;
-	new_fte->owner = thread_current ();
-	list_push_back (&frame_table, &new_fte->listelem);
-	
+	s->owner = thread_current ();
+	s->spte = spte;
+	share (fte, s);
 	lock_release (&ft_lock);
-	return kpage;
+	return true;
 }
 
+/*
+ * pseudOS: Unmaps the current process's page SPTE and frees its frame, if it
+ * is resident.  If the page is being evicted, waits for that to finish first.
+ */
 void
-frame_table_remove (void *upage)
+frame_table_remove (struct spt_entry_t *spte)
 {
-	if(is_kernel_vaddr (upage)) 
+	if(is_kernel_vaddr (spte->upage)) 
 		return;
 	
-	struct frame_table_entry_t *fte = frame_table_get_entry (upage);
-	if(fte != NULL)
+	struct thread *t = thread_current ();
+
+	/* pseudOS: look the frame up under the lock, so that it cannot be evicted
+	   in between. */
+	lock_acquire (&ft_lock);
+	while (spte->evicting)
+		cond_wait (&evict_done, &ft_lock);
+	void *kpage = pagedir_get_page (t->pagedir, spte->upage);
+	if (kpage == NULL)
 	{
-		lock_acquire (&ft_lock);
-		list_remove (&fte->listelem);
-		free (fte);
 		lock_release (&ft_lock);
-	} 
-	else 
+		return;
+	}
+
+	if (kpage == zero_page)
+	{
+		pagedir_clear_page (t->pagedir, spte->upage);
+		lock_release (&ft_lock);
+		return;
+	}
+
+	/* pseudOS: a shared frame is freed when its last sharer unmaps it. */
+	struct frame_table_entry_t *fte = frame_table_get_entry (kpage);
+	if (!list_empty (&fte->sharers))
+	{
+		if (!unshare (fte, t, spte))
+			PANIC ("Cannot find shared frame (upage=%p)!", spte->upage);
+		if (!list_empty (&fte->sharers))
+		{
+			pagedir_clear_page (t->pagedir, spte->upage);
+			lock_release (&ft_lock);
+			return;
+		}
+		if (fte->inode != NULL)
+			hash_delete (&shared_frames, &fte->hashelem);
+		fte->inode = NULL;
+	}
+	else if (fte->owner != t || fte->spte != spte)
+		PANIC ("Cannot find frame (upage=%p)!", spte->upage);
+
+	fte->owner = NULL;
+	fte->spte = NULL;
+	fte->pinned = false;
+	free_cnt++;
+	pagedir_clear_page (t->pagedir, spte->upage);
+	lock_release (&ft_lock);
+
+	palloc_free_page (kpage);
+}
+
+/*
+ * pseudOS: Returns true if KPAGE, a frame mapped by the current process, is
+ * shared with other processes.
+ */
+bool
+frame_table_is_shared (const void *kpage)
+{
+	lock_acquire (&ft_lock);
+	bool shared = kpage != zero_page
+		&& !list_empty (&frame_table_get_entry ((void *) kpage)->sharers);
+	lock_release (&ft_lock);
+	return shared;
+}
+
+/*
+ * pseudOS: Maps page PSPTE of PARENT, which must be blocked, at SPTE of the
+ * current process, its child, if it is resident.  Both then map its frame
+ * read-only, and copy it on their first write with frame_table_copy_on_write().
+ * The child's page is dirty if the page has no up-to-date copy that belongs to
+ * the child, that is unless it is a clean file page.  Returns false if memory
+ * runs out.
+ */
+bool
+frame_table_fork (struct thread *parent, struct spt_entry_t *pspte,
+				  struct spt_entry_t *spte)
+{
+	struct thread *t = thread_current ();
+	struct frame_sharer *ps = slab_alloc (&sharer_cache);
+	struct frame_sharer *cs = slab_alloc (&sharer_cache);
+	bool success = ps != NULL && cs != NULL;
+
+	lock_acquire (&ft_lock);
+	while (pspte->evicting)
+		cond_wait (&evict_done, &ft_lock);
+	void *kpage = pagedir_get_page (parent->pagedir, pspte->upage);
+	if (!success || kpage == NULL)
+		;
+	else if (kpage == zero_page)
+		success = install_page (spte->upage, zero_page, false);
+	else if ((success = install_page (spte->upage, kpage, false)))
 	{
-		PANIC ("Cannot find frame (upage=%p)!", upage);
+		struct frame_table_entry_t *fte = frame_table_get_entry (kpage);
+		uint32_t *pd = parent->pagedir;
+		bool dirty = pagedir_is_dirty (pd, pspte->upage);
+		if (list_empty (&fte->sharers))
+		{
+			/* pseudOS: write-protect the parent's page, keeping its
+			   accessed and dirty bits. */
+			bool accessed = pagedir_is_accessed (pd, pspte->upage);
+			pagedir_clear_page (pd, pspte->upage);
+			pagedir_set_page (pd, pspte->upage, kpage, false);
+			pagedir_set_accessed (pd, pspte->upage, accessed);
+			pagedir_set_dirty (pd, pspte->upage, dirty);
+			ps->owner = parent;
+			ps->spte = pspte;
+			share (fte, ps);
+			ps = NULL;
+		}
+		pagedir_set_dirty (t->pagedir, spte->upage,
+						   dirty || pspte->swap_page_index != SWAP_INIT_IDX);
+		cs->owner = t;
+		cs->spte = spte;
+		share (fte, cs);
+		cs = NULL;
 	}
+	lock_release (&ft_lock);
+
+	slab_free (&sharer_cache, ps);
+	slab_free (&sharer_cache, cs);
+	return success;
 }
 
-static struct frame_table_entry_t *
-frame_table_get_entry (void *upage)
+/*
+ * pseudOS: Gives the current process's page SPTE, which maps a copy-on-write
+ * frame, a writable frame of its own.  If other processes still share the
+ * frame, its contents are copied to a new frame, otherwise the frame is just
+ * made writable.  The page must be pinned, which keeps the shared frame from
+ * being evicted while it is copied.  Returns false if memory runs out, in
+ * which case the page still maps the shared frame.
+ */
+bool
+frame_table_copy_on_write (struct spt_entry_t *spte)
 {
-	if(upage == NULL)
-		return NULL;
+	struct thread *t = thread_current ();
+	void *kpage = pagedir_get_page (t->pagedir, spte->upage);
+	void *copy = NULL;
+
+	ASSERT (kpage != NULL && kpage != zero_page);
+	struct frame_table_entry_t *fte = frame_table_get_entry (kpage);
 
+	/* pseudOS: the shared frame is read-only for all of its sharers, so it
+	   can be copied without ft_lock.  Another process may fork meanwhile and
+	   add a sharer, in which case a copy is needed after all. */
 	lock_acquire (&ft_lock);
+	while (copy == NULL && list_size (&fte->sharers) > 1)
+	{
+		lock_release (&ft_lock);
+		copy = alloc_frame (true);
+		if (copy == NULL)
+			return false;
+		memcpy (copy, kpage, PGSIZE);
+		lock_acquire (&ft_lock);
+	}
+
+	if (!unshare (fte, t, spte))
+		PANIC ("Cannot find shared frame (upage=%p)!", spte->upage);
+	pagedir_clear_page (t->pagedir, spte->upage);
+	if (list_empty (&fte->sharers))
+	{
+		/* pseudOS: the other sharers are gone, keep the frame. */
+		ASSERT (fte->owner == t && fte->spte == spte);
+		pagedir_set_page (t->pagedir, spte->upage, kpage, true);
+		pagedir_set_dirty (t->pagedir, spte->upage, true);
+		lock_release (&ft_lock);
+		if (copy != NULL)
+			free_frame (copy);
+		return true;
+	}
+
+	/* pseudOS: the page table is there, the shared frame was mapped. */
+	if (!pagedir_set_page (t->pagedir, spte->upage, copy, true))
+		PANIC ("Cannot map copied frame (upage=%p)!", spte->upage);
+	pagedir_set_dirty (t->pagedir, spte->upage, true);
+	fte = frame_table_get_entry (copy);
+	fte->spte = spte;
+	fte->owner = t;
+	lock_release (&ft_lock);
+
+	frame_table_unpin (copy);
+	return true;
+}
+
+/*
+ * pseudOS: Maps the shared zero page read-only at the current process's page
+ * SPTE, which must not be resident.  A write to it faults, and then gets the
+ * page a frame of its own.  Returns false if memory for the page table runs
+ * out.
+ */
+bool
+frame_table_map_zero (struct spt_entry_t *spte)
+{
+	lock_acquire (&ft_lock);
+	bool success = install_page (spte->upage, zero_page, false);
+	lock_release (&ft_lock);
+	return success;
+}
+
+/*
+ * pseudOS: Returns true if KPAGE is the shared zero page.
+ */
+bool
+frame_table_is_zero (const void *kpage)
+{
+	return kpage == zero_page;
+}
+
+/*
+ * pseudOS: Waits until SPTE is not being evicted, so that its swap slot or
+ * backing file holds its current contents if it is not resident.
+ */
+void
+frame_table_wait_evicted (struct spt_entry_t *spte)
+{
+	lock_acquire (&ft_lock);
+	while (spte->evicting)
+		cond_wait (&evict_done, &ft_lock);
+	lock_release (&ft_lock);
+}
+
+/*
+ * pseudOS: Returns the frame table entry of frame KPAGE, which must be in the
+ * user pool.
+ */
+static struct frame_table_entry_t *
+frame_table_get_entry (void *kpage)
+{
+	size_t idx = (vtop (kpage) >> PGBITS) - base_pfn;
+
+	ASSERT (idx < frame_cnt);
+	return &frame_table[idx];
+}
+
+/*
+ * pseudOS: Returns a hash value for the file page of shared frame E.
+ */
+static unsigned
+shared_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct frame_table_entry_t *fte = 
+		hash_entry (e, struct frame_table_entry_t, hashelem);
+	return hash_bytes (&fte->inode, sizeof fte->inode) ^ hash_int (fte->ofs);
+}
+
+/*
+ * pseudOS: Orders shared frames A and B by file page.
+ */
+static bool
+shared_less (const struct hash_elem *a_, const struct hash_elem *b_,
+			 void *aux UNUSED)
+{
+	const struct frame_table_entry_t *a = 
+		hash_entry (a_, struct frame_table_entry_t, hashelem);
+	const struct frame_table_entry_t *b = 
+		hash_entry (b_, struct frame_table_entry_t, hashelem);
+	if (a->inode != b->inode)
+		return (uintptr_t) a->inode < (uintptr_t) b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
+
+/*
+ * pseudOS: Returns the shared frame that holds the file page of SPTE, or NULL
+ * if there is none.  Must be called with ft_lock held.
+ */
+static struct frame_table_entry_t *
+shared_lookup (struct spt_entry_t *spte)
+{
+	struct frame_table_entry_t key;
+	struct hash_elem *e;
+
+	key.inode = file_get_inode (spte->file);
+	key.ofs = spte->ofs;
+	key.read_bytes = spte->read_bytes;
+	e = hash_find (&shared_frames, &key.hashelem);
+	return e != NULL ? hash_entry (e, struct frame_table_entry_t, hashelem) : NULL;
+}
+
+/*
+ * pseudOS: Adds S to the sharers of shared frame FTE.  Must be called with
+ * ft_lock held.
+ */
+static void
+share (struct frame_table_entry_t *fte, struct frame_sharer *s)
+{
+	list_push_back (&fte->sharers, &s->elem);
+}
+
+/*
+ * pseudOS: Removes page SPTE of OWNER from the sharers of shared frame FTE, and
+ * makes another sharer the frame's owner if it was.  Returns false if it is not
+ * a sharer.  Must be called with ft_lock held.
+ */
+static bool
+unshare (struct frame_table_entry_t *fte, struct thread *owner,
+		 struct spt_entry_t *spte)
+{
 	struct list_elem *e;
-	for (e = list_begin (&frame_table); 
-		 e != list_end (&frame_table); 
+
+	for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
 		 e = list_next (e))
 	{
-		struct frame_table_entry_t *fte = list_entry (e, struct frame_table_entry_t, listelem);
-		if(fte->spte->upage == upage)
+		struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+		if (s->owner != owner || s->spte != spte)
+			continue;
+
+		list_remove (e);
+		slab_free (&sharer_cache, s);
+		if (fte->owner == owner && fte->spte == spte && !list_empty (&fte->sharers))
 		{
-			lock_release (&ft_lock);
-			return fte;
+			s = list_entry (list_front (&fte->sharers), struct frame_sharer, elem);
+			fte->owner = s->owner;
+			fte->spte = s->spte;
 		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * pseudOS: Evicts shared frame FTE, selected by frame_table_evict_frame(), and
+ * returns it zeroed.  The frame is unmapped from every sharer, and then each
+ * sharer's page is written back on its own, like a page in a frame of its own.
+ * Read-only file pages are clean and need no I/O.  Must be called with ft_lock
+ * held, which is released.
+ */
+static void *
+evict_shared (struct frame_table_entry_t *fte)
+{
+	void *kpage = frame_kpage (fte);
+	struct list sharers;
+	struct list_elem *e;
+
+	for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+		 e = list_next (e))
+	{
+		struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+		s->dirty = pagedir_is_dirty (s->owner->pagedir, s->spte->upage);
+		pagedir_clear_page (s->owner->pagedir, s->spte->upage);
+		s->spte->evicting = true;
 	}
+	list_init (&sharers);
+	list_splice (list_end (&sharers), list_begin (&fte->sharers),
+				 list_end (&fte->sharers));
+	if (fte->inode != NULL)
+		hash_delete (&shared_frames, &fte->hashelem);
+	fte->inode = NULL;
+	fte->owner = NULL;
+	fte->spte = NULL;
+	fte->pinned = true;
 	lock_release (&ft_lock);
-	return NULL;
+
+	for (e = list_begin (&sharers); e != list_end (&sharers); e = list_next (e))
+	{
+		struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+		write_back (s->spte, s->owner, kpage, s->dirty);
+	}
+
+	lock_acquire (&ft_lock);
+	while (!list_empty (&sharers))
+	{
+		struct frame_sharer *s = 
+			list_entry (list_pop_front (&sharers), struct frame_sharer, elem);
+		s->spte->evicting = false;
+		slab_free (&sharer_cache, s);
+	}
+	cond_broadcast (&evict_done, &ft_lock);
+	lock_release (&ft_lock);
+
+	memset (kpage, 0, PGSIZE);
+	return kpage;
 }
 
+/*
+ * pseudOS: Returns true if FTE's page was accessed, by any of its sharers if
+ * the frame is shared.
+ */
+static bool
+frame_is_accessed (struct frame_table_entry_t *fte)
+{
+	struct list_elem *e;
+
+	if (list_empty (&fte->sharers))
+		return pagedir_is_accessed (fte->owner->pagedir, fte->spte->upage);
+	for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+		 e = list_next (e))
+	{
+		struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+		if (pagedir_is_accessed (s->owner->pagedir, s->spte->upage))
+			return true;
+	}
+	return false;
+}
 
+/*
+ * pseudOS: Clears the accessed bits of FTE's page, in all of its sharers if the
+ * frame is shared.
+ */
 static void
+frame_clear_accessed (struct frame_table_entry_t *fte)
+{
+	struct list_elem *e;
+
+	if (list_empty (&fte->sharers))
+	{
+		pagedir_set_accessed (fte->owner->pagedir, fte->spte->upage, false);
+		return;
+	}
+	for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+		 e = list_next (e))
+	{
+		struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+		pagedir_set_accessed (s->owner->pagedir, s->spte->upage, false);
+	}
+}
+
+/*
+ * pseudOS: Returns true if FTE's page has to be written back, for any of its
+ * sharers if the frame is shared.
+ */
+static bool
+frame_is_dirty (struct frame_table_entry_t *fte)
+{
+	struct list_elem *e;
+
+	if (list_empty (&fte->sharers))
+		return pagedir_is_dirty (fte->owner->pagedir, fte->spte->upage);
+	for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+		 e = list_next (e))
+	{
+		struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+		if (pagedir_is_dirty (s->owner->pagedir, s->spte->upage))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * pseudOS: Returns the kernel virtual address of the frame of FTE.
+ */
+static void *
+frame_kpage (struct frame_table_entry_t *fte)
+{
+	return ptov ((base_pfn + (size_t) (fte - frame_table)) << PGBITS);
+}
+
+/*
+ * pseudOS: Evicts a page and returns its frame, zeroed, for reuse by the
+ * caller.  Clean pages are preferred, see eclock_select().  The victim is
+ * chosen and unmapped under ft_lock, but written back after releasing it.
+ * Until then its frame stays pinned and its page is marked as being evicted,
+ * which makes its owner wait in spt_load_page() if it faults it back in.
+ */
+static void *
 frame_table_evict_frame (void)
 {	
-	struct list_elem *e = list_begin(&frame_table);
-	struct frame_table_entry_t *fte = NULL;
-	for(; e != list_end(&frame_table); e = list_next(e))
-	{	
-		struct frame_table_entry_t *tmp_fte = list_entry(e, struct frame_table_entry_t, listelem);
-
-		if(tmp_fte->spte->pinned == SPT_UNPINNED && tmp_fte->spte->upage != NULL 
-			&& is_user_vaddr (tmp_fte->spte->upage))
-		{
-			if(fte == NULL || fte->spte->lru_ticks > tmp_fte->spte->lru_ticks)
-				fte = tmp_fte;
-		}
+	lock_acquire (&ft_lock);
+	struct frame_table_entry_t *fte = (frame_policy == FRAME_POLICY_ECLOCK)
+		? eclock_select ()
+		: clock_select ();
+	if (fte == NULL)
+		PANIC ("No frame to evict, all frames are pinned!");
 
-		if(fte == NULL && e == list_end (&frame_table))
-			e = list_begin (&frame_table);
-	}
+	struct thread *owner = fte->owner;
+	struct spt_entry_t *spte = fte->spte;
+	void *kpage = frame_kpage (fte);
+
+	if (!list_empty (&fte->sharers))
+		return evict_shared (fte);
+
+	bool dirty = pagedir_is_dirty (owner->pagedir, spte->upage);
 
-	struct child_process *cp = fte->owner->child_info;
-	void *kpage = pagedir_get_page (fte->owner->pagedir, fte->spte->upage);
-	if(fte->spte->type == SPT_ENTRY_TYPE_SWAP)
+	pagedir_clear_page (owner->pagedir, spte->upage);
+	spte->evicting = true;
+	fte->owner = NULL;
+	fte->spte = NULL;
+	fte->pinned = true;
+	lock_release (&ft_lock);
+
+	write_back (spte, owner, kpage, dirty);
+
+	lock_acquire (&ft_lock);
+	spte->evicting = false;
+	cond_broadcast (&evict_done, &ft_lock);
+	lock_release (&ft_lock);
+
+	memset (kpage, 0, PGSIZE);
+	return kpage;
+}
+
+/*
+ * pseudOS: Brings the backing store of SPTE, a page of OWNER whose contents are
+ * in KPAGE, up to date, if DIRTY is true.  Anonymous pages go to swap, into the
+ * slot they already have if they were written back before, and memory-mapped
+ * pages to their file.  Clean pages need no I/O: the swap slot or the file
+ * still has their contents.  Must be called without ft_lock held, and with
+ * SPTE marked as being written back.
+ */
+static void
+write_back (struct spt_entry_t *spte, struct thread *owner, void *kpage, 
+			bool dirty)
+{
+	ASSERT (spte->evicting);
+
+	if(spte->type == SPT_ENTRY_TYPE_SWAP)
 	{
-		fte->spte->swap_page_index = (pagedir_is_dirty (fte->owner->pagedir, fte->spte->upage))
-			? swap_evict (kpage)
-			: SWAP_INIT_IDX;
+		if (!dirty)
+			return;
+		if (spte->swap_page_index == SWAP_INIT_IDX)
+			spte->swap_page_index = swap_evict (kpage, owner, spte->upage);
+		else
+			spte->swap_page_index = swap_rewrite (spte->swap_page_index, kpage,
+												  owner, spte->upage);
 	} 
-	else if (fte->spte->type == SPT_ENTRY_TYPE_MMAP)
+	else if (spte->type == SPT_ENTRY_TYPE_MMAP)
 	{
-		fte->spte->swap_page_index = SWAP_INIT_IDX;
+		if (!dirty)
+			return;
 		lock_acquire (&syscall_lock);
-		off_t written_bytes = file_write_at (fte->spte->file, kpage, 
-											 fte->spte->read_bytes, fte->spte->ofs);
+		off_t written_bytes = file_write_at (spte->file, kpage, 
+											 spte->read_bytes, spte->ofs);
 		lock_release (&syscall_lock);
-		if((off_t)fte->spte->read_bytes != written_bytes)
+		if((off_t)spte->read_bytes != written_bytes)
 		{
-			PANIC ("Cannot write all bytes (%d/%d)", written_bytes, fte->spte->read_bytes);
+			PANIC ("Cannot write all bytes (%d/%d)", written_bytes, spte->read_bytes);
 		}
 	}
 	else
 	{
 		PANIC ("Invalid supplement page table entry type (upage=%p, type=%d)!", 
-			fte->spte->upage, fte->spte->type);
+			spte->upage, spte->type);
 	}
+}
 
-	if(!sema_try_down(&cp->alive))
+/*
+ * pseudOS: Wakes up the pageout daemon, creating it the first time, if few
+ * frames are free.  Must be called with ft_lock held.
+ */
+static void
+request_pageout (void)
+{
+	ASSERT (lock_held_by_current_thread (&ft_lock));
+
+	if (free_cnt >= low_water ())
+		return;
+	if (!pageout_started)
+		pageout_started = thread_create ("pageout", PRI_DEFAULT, 
+										 pageout_daemon, NULL) != TID_ERROR;
+	pageout_requested = true;
+	cond_signal (&pageout_wanted, &ft_lock);
+}
+
+/*
+ * pseudOS: Returns the number of free frames below which the pageout daemon
+ * runs.
+ */
+static size_t
+low_water (void)
+{
+	return frame_cnt / PAGEOUT_LOW_WATER + 1;
+}
+
+/*
+ * pseudOS: Thread function of the pageout daemon.  Runs a pass each time it is
+ * woken up.
+ */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+	for (;;)
 	{
-		pagedir_set_accessed (fte->owner->pagedir, fte->spte->upage, false);
-		pagedir_clear_page (fte->owner->pagedir, fte->spte->upage);
+		lock_acquire (&ft_lock);
+		while (!pageout_requested)
+			cond_wait (&pageout_wanted, &ft_lock);
+		pageout_requested = false;
+		lock_release (&ft_lock);
+
+		pageout_pass ();
 	}
-	else
-		sema_up(&cp->alive);
-	list_remove (&fte->listelem);
-	palloc_free_page (kpage);
-	free (fte);
+}
+
+/*
+ * pseudOS: Walks the frames from the daemon's hand on, and writes back dirty
+ * pages that were not accessed recently, until there are enough clean ones for
+ * eviction.  A page being written back stays mapped, but is pinned and marked
+ * as being written back.  Its dirty bit is cleared before the write, so that a
+ * store by its owner in the meantime makes it dirty again.  Anonymous pages
+ * that need a new swap slot are gathered and swapped out SWAP_BATCH at a time,
+ * into consecutive slots.
+ */
+static void
+pageout_pass (void)
+{
+	struct swap_page batch[SWAP_BATCH];
+	struct frame_table_entry_t *batch_ftes[SWAP_BATCH];
+	size_t batch_cnt = 0;
+	size_t clean_cnt = 0, i;
+
+	lock_acquire (&ft_lock);
+	for (i = 0; i < frame_cnt && clean_cnt < frame_cnt / PAGEOUT_CLEAN; i++)
+	{
+		struct frame_table_entry_t *fte = &frame_table[pageout_hand];
+		pageout_hand = (pageout_hand + 1) % frame_cnt;
+		if (!is_evictable (fte) || frame_is_accessed (fte))
+			continue;
+
+		/* pseudOS: shared frames are only written back by eviction. */
+		bool dirty = frame_is_dirty (fte);
+		if (dirty && !list_empty (&fte->sharers))
+			continue;
+
+		clean_cnt++;
+		if (!dirty)
+			continue;
+
+		struct thread *owner = fte->owner;
+		struct spt_entry_t *spte = fte->spte;
+		void *kpage = frame_kpage (fte);
+		pagedir_set_dirty (owner->pagedir, spte->upage, false);
+		spte->evicting = true;
+		fte->pinned = true;
+
+		if (spte->type == SPT_ENTRY_TYPE_SWAP 
+			&& spte->swap_page_index == SWAP_INIT_IDX)
+		{
+			batch[batch_cnt].kpage = kpage;
+			batch[batch_cnt].owner = owner;
+			batch[batch_cnt].upage = spte->upage;
+			batch_ftes[batch_cnt++] = fte;
+			if (batch_cnt == SWAP_BATCH)
+			{
+				pageout_batch (batch, batch_ftes, batch_cnt);
+				batch_cnt = 0;
+			}
+			continue;
+		}
+
+		lock_release (&ft_lock);
+		write_back (spte, owner, kpage, true);
+		lock_acquire (&ft_lock);
+		spte->evicting = false;
+		fte->pinned = false;
+		cond_broadcast (&evict_done, &ft_lock);
+	}
+	if (batch_cnt > 0)
+		pageout_batch (batch, batch_ftes, batch_cnt);
+	lock_release (&ft_lock);
+}
+
+/*
+ * pseudOS: Swaps out the CNT pages in BATCH, whose frames are FTES, with a
+ * single write, and stores their slots.  The pages must be pinned and marked as
+ * being written back.  Must be called with ft_lock held, which is released
+ * during the write.
+ */
+static void
+pageout_batch (struct swap_page *batch, struct frame_table_entry_t **ftes, 
+			   size_t cnt)
+{
+	size_t i;
+
+	lock_release (&ft_lock);
+	swap_evict_multiple (batch, cnt);
+	lock_acquire (&ft_lock);
+
+	for (i = 0; i < cnt; i++)
+	{
+		ftes[i]->spte->swap_page_index = batch[i].idx;
+		ftes[i]->spte->evicting = false;
+		ftes[i]->pinned = false;
+	}
+	cond_broadcast (&evict_done, &ft_lock);
+}
+
+/*
+ * pseudOS: Returns the frame under the clock hand and moves the hand on to the
+ * next frame, wrapping around at the end of the frame table.
+ */
+static struct frame_table_entry_t *
+clock_advance (void)
+{
+	struct frame_table_entry_t *fte = &frame_table[clock_hand];
+	clock_hand = (clock_hand + 1) % frame_cnt;
+	return fte;
+}
+
+/*
+ * pseudOS: Returns true if FTE's page may be evicted, that is unless it is
+ * pinned or locked with mlock().  A shared frame may not if any of its sharers
+ * has the page pinned or locked.
+ */
+static bool
+is_evictable (struct frame_table_entry_t *fte)
+{
+	struct list_elem *e;
+
+	if (fte->owner == NULL || fte->pinned
+		|| fte->spte->pinned != SPT_UNPINNED || fte->spte->locked
+		|| fte->spte->upage == NULL || !is_user_vaddr (fte->spte->upage))
+		return false;
+	for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+		 e = list_next (e))
+	{
+		struct spt_entry_t *spte = list_entry (e, struct frame_sharer, elem)->spte;
+		if (spte->pinned != SPT_UNPINNED || spte->locked)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * pseudOS: Clock (second chance).  Sweeps the frames from the hand on and
+ * returns the first unpinned one whose page was not accessed since the hand
+ * last passed it, clearing the accessed bits of the others on the way.  Two
+ * sweeps find a victim unless all frames are pinned, in which case NULL is
+ * returned.
+ */
+static struct frame_table_entry_t *
+clock_select (void)
+{
+	size_t i, n = 2 * frame_cnt;
+	for (i = 0; i < n; i++)
+	{
+		struct frame_table_entry_t *fte = clock_advance ();
+		if (!is_evictable (fte))
+			continue;
+
+		if (!frame_is_accessed (fte))
+			return fte;
+		frame_clear_accessed (fte);
+	}
+	return NULL;
+}
+
+/*
+ * pseudOS: Enhanced clock.  Prefers, in this order, frames that are
+ * (not accessed, clean), (not accessed, dirty), (accessed, clean) and
+ * (accessed, dirty), so that clean pages, which need no write-back, go first.
+ * Each round first sweeps for a not accessed, clean frame without changing
+ * anything, then sweeps for a not accessed, dirty one, clearing accessed bits
+ * on the way.  After two rounds every unpinned frame is not accessed, so a
+ * victim is found unless all frames are pinned.
+ */
+static struct frame_table_entry_t *
+eclock_select (void)
+{
+	size_t n = frame_cnt;
+	int round;
+	for (round = 0; round < 2; round++)
+	{
+		size_t i;
+		for (i = 0; i < n; i++)
+		{
+			struct frame_table_entry_t *fte = clock_advance ();
+			if (is_evictable (fte) && !frame_is_accessed (fte) 
+				&& !frame_is_dirty (fte))
+				return fte;
+		}
+		for (i = 0; i < n; i++)
+		{
+			struct frame_table_entry_t *fte = clock_advance ();
+			if (!is_evictable (fte))
+				continue;
+
+			if (!frame_is_accessed (fte))
+				return fte;
+			frame_clear_accessed (fte);
+		}
+	}
+	return NULL;
 }
\ No newline at end of file
@@ -4,19 +4,61 @@
  * pseudOS
  */
 #include "vm/page.h"
+#include <hash.h>
 #include <list.h>
-#include <bitmap.h>
 
+/* pseudOS: A frame of the user pool.  OWNER and SPTE map the frame back to the
+   page in it, and are NULL if the frame is free.  A shared frame is mapped
+   read-only by several processes.  SHARERS then holds a frame_sharer for each
+   of them, and OWNER and SPTE are one of them.  A shared frame either holds a
+   read-only file page, and is found in the shared frame table by INODE, OFS
+   and READ_BYTES, or is copy-on-write after fork(), and INODE is NULL. */
 struct frame_table_entry_t
 {
-	struct list_elem listelem;
-	struct thread *owner;
-	struct spt_entry_t *spte;
+	struct thread *owner;		/* Process whose page is in the frame. */
+	struct spt_entry_t *spte;	/* The page in the frame. */
+	bool pinned;				/* Being filled in or evicted. */
+	struct list sharers;		/* Pages mapping a shared frame, else empty. */
+	struct hash_elem hashelem;	/* Element in the shared frame table. */
+	struct inode *inode;		/* File of a shared file page, else NULL. */
+	off_t ofs;					/* Offset of its page in the file. */
+	uint32_t read_bytes;		/* Bytes of the page read from the file. */
 };
 
+/* pseudOS: A page of a process that maps a shared frame. */
+struct frame_sharer
+{
+	struct list_elem elem;		/* Element in the frame's sharers. */
+	struct thread *owner;		/* Process. */
+	struct spt_entry_t *spte;	/* Its page. */
+	bool dirty;					/* Page dirty when it was evicted. */
+};
+
+/* pseudOS: Page replacement policies. */
+enum frame_policy
+{
+	FRAME_POLICY_CLOCK,		/* Clock (second chance). */
+	FRAME_POLICY_ECLOCK		/* Enhanced clock, prefers clean pages. */
+};
+
+extern enum frame_policy frame_policy;
+
 void frame_table_init (void);
-void init_frame_table(struct list *ft);
-void frame_table_remove (void *upage);
+bool frame_set_policy (const char *name);
+void frame_table_remove (struct spt_entry_t *spte);
+void frame_table_wait_evicted (struct spt_entry_t *spte);
+bool frame_table_map_zero (struct spt_entry_t *spte);
+bool frame_table_is_zero (const void *kpage);
+bool frame_table_share (struct spt_entry_t *spte);
+bool frame_table_is_shared (const void *kpage);
+bool frame_table_fork (struct thread *parent, struct spt_entry_t *pspte,
+					   struct spt_entry_t *spte);
+bool frame_table_copy_on_write (struct spt_entry_t *spte);
 void * frame_table_insert (struct spt_entry_t *stpe);
+void * frame_table_try_insert (struct spt_entry_t *spte);
+void frame_table_unpin (void *kpage);
+bool frame_table_has_free (void);
+bool frame_table_reserve_locked (size_t cnt);
+void frame_table_release_locked (size_t cnt);
 
 #endif
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/interrupt.h"
@@ -15,12 +16,47 @@
 #include "userprog/syscall.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/region.h"
 #include "vm/swap.h"
 
 #include <string.h>
 
 static bool spt_load_page_swap (struct spt_entry_t *spte);
 static bool spt_load_page_file (struct spt_entry_t *spte);
+static bool spt_load_around (struct spt_entry_t *spte, bool sequential);
+static int spt_advice (const struct spt_entry_t *spte);
+static bool page_range (const void *addr, size_t len, uint8_t **first,
+						uint8_t **end);
+static void spt_swap_readahead (int32_t idx);
+
+/* pseudOS: Most pages a read fault on a file-backed page loads, set with the
+   -faultaround option.  1 or less disables fault-around. */
+int spt_fault_around = SPT_FAULT_AROUND_DEFAULT;
+
+/* pseudOS: Cache of supplemental page table entries. */
+static struct slab_cache spte_cache;
+
+/* pseudOS: Buffer for the file data of spt_load_around(), spt_fault_around
+   pages. */
+static struct lock around_lock;
+static uint8_t *around_buffer;
+
+/*
+ * pseudOS: Initializes the cache of entries and fault-around.  Disables
+ * fault-around if there is not enough memory for its buffer.
+ */
+void
+spt_module_init (void)
+{
+	slab_cache_init (&spte_cache, "spt_entry", sizeof (struct spt_entry_t), NULL);
+	lock_init (&around_lock);
+	if (spt_fault_around > SPT_FAULT_AROUND_MAX)
+		spt_fault_around = SPT_FAULT_AROUND_MAX;
+	if (spt_fault_around > 1)
+		around_buffer = palloc_get_multiple (0, spt_fault_around);
+	if (around_buffer == NULL)
+		spt_fault_around = 1;
+}
 	
 void 
 spt_init(struct hash *spt)
@@ -40,7 +76,9 @@ spt_insert (struct hash *spt, struct file *file, off_t ofs, uint8_t *upage,
 		return NULL;
 	}
 
-	struct spt_entry_t *e = malloc(sizeof(struct spt_entry_t));
+	struct spt_entry_t *e = slab_alloc (&spte_cache);
+	if(e == NULL)
+		return NULL;
 	e->file = file;
 	e->ofs = ofs;
 	e->upage = upage;
@@ -50,13 +88,14 @@ spt_insert (struct hash *spt, struct file *file, off_t ofs, uint8_t *upage,
 	e->type = type;
 	e->swap_page_index = SWAP_INIT_IDX;
 	e->pinned = pinned;
-	e->lru_ticks = timer_ticks();
+	e->evicting = false;
+	e->locked = false;
 	
 	struct hash_elem *he = hash_insert (spt, &e->hashelem);
 
 	if(he != NULL) 
 	{
-		free (e);
+		slab_free (&spte_cache, e);
 		return NULL;
 	}
 	return e;
@@ -106,6 +145,34 @@ spt_lookup (struct hash *spt, const void *upage)
   return helem != NULL ? hash_entry (helem, struct spt_entry_t, hashelem) : NULL;
 }
 
+/*
+ * pseudOS: Returns the entry of the current process for the page that contains
+ * VADDR.  The entry of a page in a region is created on first use.  Returns
+ * NULL if VADDR is in no page or region, or if memory runs out.
+ */
+struct spt_entry_t *
+spt_find (const void *vaddr)
+{
+	struct thread *t = thread_current ();
+	struct spt_entry_t *spte = spt_lookup (t->spt, vaddr);
+	if(spte != NULL)
+		return spte;
+
+	struct region *r = region_find (&t->regions, vaddr);
+	if(r == NULL)
+		return NULL;
+
+	uint8_t *upage = pg_round_down (vaddr);
+	off_t offset = upage - r->start;
+	off_t read_bytes = r->file_bytes - offset;
+	if(read_bytes < 0)
+		read_bytes = 0;
+	else if(read_bytes > PGSIZE)
+		read_bytes = PGSIZE;
+	return spt_insert (t->spt, r->file, r->ofs + offset, upage, read_bytes, 
+					   PGSIZE - read_bytes, r->writable, r->pinned, r->type);
+}
+
 /* pseudOS: Frees all resources of the supplemental page table
  * (including the supplemental page table itself).
  */
@@ -116,6 +183,70 @@ spt_free (struct hash *spt)
 	free (spt);
 }
 
+/*
+ * pseudOS: Copies the supplemental page table and regions of PARENT, which must
+ * be blocked, into the current process's, its child by fork().  Resident pages
+ * are shared copy-on-write, pages in swap are copied into frames of the child,
+ * and file pages are read from EXECUTABLE, the child's copy of the parent's
+ * executable, when the child first touches them.  Memory-mapped files are not
+ * inherited.
+ * Returns false if memory runs out.
+ */
+bool
+spt_fork (struct thread *parent, struct file *executable)
+{
+	struct thread *t = thread_current ();
+	struct hash_iterator i;
+	struct list_elem *e;
+
+	for (e = list_begin (&parent->regions); e != list_end (&parent->regions);
+		 e = list_next (e))
+	{
+		struct region *r = list_entry (e, struct region, elem);
+		struct region *copy;
+		if(r->type != SPT_ENTRY_TYPE_SWAP)
+			continue;
+
+		copy = region_add (&t->regions, r->start, r->page_cnt, executable, r->ofs,
+						   r->file_bytes, r->writable, r->pinned, r->type);
+		if(copy == NULL)
+			return false;
+		/* pseudOS: madvise() advice is inherited along with the mapping. */
+		copy->advice = r->advice;
+	}
+
+	hash_first (&i, parent->spt);
+	while (hash_next (&i))
+	{
+		struct spt_entry_t *pspte = hash_entry (hash_cur (&i), struct spt_entry_t, hashelem);
+		if(pspte->type != SPT_ENTRY_TYPE_SWAP)
+			continue;
+
+		struct spt_entry_t *spte = spt_insert (t->spt, 
+			pspte->file != NULL ? executable : NULL, pspte->ofs, pspte->upage, 
+			pspte->read_bytes, pspte->zero_bytes, pspte->writable, SPT_UNPINNED, 
+			pspte->type);
+		if(spte == NULL || !frame_table_fork (parent, pspte, spte))
+			return false;
+
+		/* pseudOS: a page that was not resident keeps its swap slot, which
+		   the parent still owns. */
+		frame_table_wait_evicted (spte);
+		if(pagedir_get_page (t->pagedir, spte->upage) == NULL
+		   && spte->swap_page_index == SWAP_INIT_IDX
+		   && pspte->swap_page_index != SWAP_INIT_IDX)
+		{
+			void *kpage = frame_table_insert (spte);
+			if(kpage == NULL)
+				return false;
+			swap_read (pspte->swap_page_index, kpage);
+			pagedir_set_dirty (t->pagedir, spte->upage, true);
+			frame_table_unpin (kpage);
+		}
+	}
+	return true;
+}
+
 void
 spt_entry_free (struct hash_elem *e, void *aux UNUSED)
 {
@@ -128,11 +259,348 @@ spt_entry_free (struct hash_elem *e, void *aux UNUSED)
 	if(pagedir_is_accessed (t->pagedir, spte->upage))
 		pagedir_set_accessed (t->pagedir, spte->upage, false);
 
-	frame_table_remove (&spte->upage);				/* release frame. */
+	if(spte->locked)								/* release mlock(). */
+	{
+		t->locked_cnt--;
+		frame_table_release_locked (1);
+	}
+	frame_table_remove (spte);						/* release frame. */
+	if(spte->swap_page_index != SWAP_INIT_IDX)		/* release swap slot. */
+		swap_release (spte->swap_page_index);
 	pagedir_clear_page (t->pagedir, spte->upage);	/* remove pagedir entry. */
-	free (spte);									/* free entry itself. */
+	slab_free (&spte_cache, spte);					/* free entry itself. */
+}
+
+/*
+ * pseudOS: Returns true if SPTE is an anonymous page that has never been
+ * written, or was evicted without being written, so that it is all zeros.
+ */
+bool
+spt_is_zero_fill (const struct spt_entry_t *spte)
+{
+	return spte->type == SPT_ENTRY_TYPE_SWAP && spte->read_bytes == 0
+		&& spte->swap_page_index == SWAP_INIT_IDX;
+}
+
+/*
+ * pseudOS: Returns true if SPTE is a read-only page of a file that is never
+ * written back, so that every process mapping the same file page can share
+ * one frame for it.  These are the text and read-only data of executables,
+ * which cannot be written while they are running.
+ */
+bool
+spt_is_shareable (const struct spt_entry_t *spte)
+{
+	return spte->type == SPT_ENTRY_TYPE_SWAP && !spte->writable
+		&& spte->file != NULL && spte->read_bytes > 0
+		&& spte->swap_page_index == SWAP_INIT_IDX;
+}
+
+/*
+ * pseudOS: Handles a page fault of the current process on SPTE, a write fault
+ * if WRITE is true.  A read fault on a zero-fill page maps the shared zero
+ * page, and on a read-only file page maps the shared frame that holds it, if
+ * any.  Everything else is loaded into a frame of its own, with fault-around
+ * unless the page's region was advised as random.  Returns true if the access
+ * can be retried.
+ */
+bool
+spt_fault (struct spt_entry_t *spte, bool write)
+{
+	if(!write)
+	{
+		frame_table_wait_evicted (spte);
+		if(pagedir_get_page (thread_current ()->pagedir, spte->upage) == NULL)
+		{
+			int advice = spt_advice (spte);
+			if(spt_is_zero_fill (spte))
+				return frame_table_map_zero (spte);
+			if(frame_table_share (spte))
+				return true;
+			if(spt_fault_around > 1 && advice != MADV_RANDOM
+			   && spt_load_around (spte, advice == MADV_SEQUENTIAL))
+				return true;
+		}
+	}
+	return spt_load_page (spte);
+}
+
+/*
+ * pseudOS: Returns the advice given with madvise() for the region of SPTE, a
+ * page of the current process, or MADV_NORMAL.
+ */
+static int
+spt_advice (const struct spt_entry_t *spte)
+{
+	struct region *r = region_find (&thread_current ()->regions, spte->upage);
+	return r != NULL ? r->advice : MADV_NORMAL;
+}
+
+/*
+ * pseudOS: Rounds the LEN bytes at ADDR out to whole pages, from *FIRST up to
+ * *END.  Returns false if they are not all in user space.
+ */
+static bool
+page_range (const void *addr, size_t len, uint8_t **first, uint8_t **end)
+{
+	uintptr_t start = (uintptr_t) addr;
+	if(start + len < start || !is_user_vaddr ((uint8_t *) start + len - (len > 0)))
+		return false;
+
+	*first = pg_round_down (addr);
+	*end = pg_round_up ((uint8_t *) addr + len);
+	return true;
+}
+
+/*
+ * pseudOS: madvise().  MADV_NORMAL, MADV_SEQUENTIAL and MADV_RANDOM set how
+ * every region that overlaps the LEN bytes at ADDR is read on a fault.
+ * MADV_WILLNEED loads the pages in the range that are not resident while
+ * there are free frames, and MADV_DONTNEED marks the resident ones not
+ * accessed, so that they are evicted first.  Returns false if ADVICE is not
+ * valid or the range is not in user space.
+ */
+bool
+spt_madvise (void *addr, size_t len, int advice)
+{
+	struct thread *t = thread_current ();
+	uint8_t *first, *end, *upage;
+	struct list_elem *e;
+
+	if(!page_range (addr, len, &first, &end))
+		return false;
+
+	switch (advice)
+	{
+		case MADV_NORMAL:
+		case MADV_SEQUENTIAL:
+		case MADV_RANDOM:
+			for (e = list_begin (&t->regions); e != list_end (&t->regions);
+				 e = list_next (e))
+			{
+				struct region *r = list_entry (e, struct region, elem);
+				if(r->start < end && first < r->start + r->page_cnt * PGSIZE)
+					r->advice = advice;
+			}
+			return true;
+
+		case MADV_WILLNEED:
+			for (upage = first; upage < end && frame_table_has_free ();
+				 upage += PGSIZE)
+			{
+				struct spt_entry_t *spte = spt_find (upage);
+				if(spte == NULL || spt_is_zero_fill (spte)
+				   || pagedir_get_page (t->pagedir, upage) != NULL)
+					continue;
+				if(spt_load_page (spte))
+					pagedir_set_accessed (t->pagedir, upage, false);
+			}
+			return true;
+
+		case MADV_DONTNEED:
+			for (upage = first; upage < end; upage += PGSIZE)
+				if(spt_lookup (t->spt, upage) != NULL
+				   && pagedir_get_page (t->pagedir, upage) != NULL)
+					pagedir_set_accessed (t->pagedir, upage, false);
+			return true;
+
+		default:
+			return false;
+	}
 }
 
+/*
+ * pseudOS: mlock().  Loads the pages of the LEN bytes at ADDR and keeps them
+ * from being evicted until they are unlocked or freed.  Fails if any of the
+ * pages does not exist, or if the process would have more than SPT_LOCKED_MAX
+ * pages locked, or all processes together more than the frame table allows.
+ * If a page cannot be loaded, the pages this call locked are unlocked again,
+ * and pages locked before are left locked.
+ */
+bool
+spt_mlock (const void *addr, size_t len)
+{
+	struct thread *t = thread_current ();
+	struct spt_entry_t *locked[SPT_LOCKED_MAX];
+	uint8_t *first, *end, *upage;
+	size_t cnt = 0, i;
+
+	if(!page_range (addr, len, &first, &end))
+		return false;
+
+	for (upage = first; upage < end; upage += PGSIZE)
+	{
+		struct spt_entry_t *spte = spt_find (upage);
+		if(spte == NULL)
+			return false;
+		if(!spte->locked)
+			cnt++;
+	}
+	if(t->locked_cnt + cnt > SPT_LOCKED_MAX || !frame_table_reserve_locked (cnt))
+		return false;
+
+	/* pseudOS: lock the pages first, so that loading one cannot evict
+	   another. */
+	cnt = 0;
+	for (upage = first; upage < end; upage += PGSIZE)
+	{
+		struct spt_entry_t *spte = spt_lookup (t->spt, upage);
+		if(spte->locked)
+			continue;
+		spte->locked = true;
+		t->locked_cnt++;
+		locked[cnt++] = spte;
+	}
+
+	for (i = 0; i < cnt; i++)
+		if(!spt_load_page (locked[i]))
+		{
+			for (i = 0; i < cnt; i++)
+				locked[i]->locked = false;
+			t->locked_cnt -= cnt;
+			frame_table_release_locked (cnt);
+			return false;
+		}
+	return true;
+}
+
+/*
+ * pseudOS: munlock().  Lets the pages of the LEN bytes at ADDR be evicted
+ * again.  Pages that were not locked are left as they are.
+ */
+bool
+spt_munlock (const void *addr, size_t len)
+{
+	struct thread *t = thread_current ();
+	uint8_t *first, *end, *upage;
+
+	if(!page_range (addr, len, &first, &end))
+		return false;
+
+	for (upage = first; upage < end; upage += PGSIZE)
+	{
+		struct spt_entry_t *spte = spt_lookup (t->spt, upage);
+		if(spte == NULL || !spte->locked)
+			continue;
+		spte->locked = false;
+		t->locked_cnt--;
+		frame_table_release_locked (1);
+	}
+	return true;
+}
+
+/*
+ * pseudOS: Returns true if SPTE of the current process is not resident and has
+ * to be read from its file, and NEXT, if it is not NULL, is the page that
+ * directly follows it in the file.
+ */
+static bool
+is_file_page (struct spt_entry_t *spte, struct spt_entry_t *next)
+{
+	if(spte == NULL || spte->file == NULL || spte->read_bytes == 0)
+		return false;
+
+	frame_table_wait_evicted (spte);
+	if(spte->swap_page_index != SWAP_INIT_IDX
+	   || pagedir_get_page (thread_current ()->pagedir, spte->upage) != NULL)
+		return false;
+
+	return next == NULL
+		|| (spte->file == next->file && spte->read_bytes == PGSIZE
+			&& spte->ofs + PGSIZE == next->ofs);
+}
+
+/*
+ * pseudOS: Fault-around.  Loads SPTE, which is not resident and has to be read
+ * from its file, together with the pages around it, within the aligned window
+ * of spt_fault_around pages that contains it, that follow each other in the
+ * same file and are not resident either.  Their contents are read with a single
+ * file read.  The other pages only get free frames and are not marked
+ * accessed, and pinned ones are left out, since their frames could not be
+ * evicted.  If SEQUENTIAL is true, the window starts at SPTE instead, and the
+ * page before SPTE is marked not accessed, so that the pages behind a
+ * sequential scan are evicted first.  Returns false, having loaded nothing, if
+ * there are no such pages or on failure.
+ */
+static bool
+spt_load_around (struct spt_entry_t *spte, bool sequential)
+{
+	struct thread *t = thread_current ();
+	struct spt_entry_t *run[SPT_FAULT_AROUND_MAX];
+	void *kpages[SPT_FAULT_AROUND_MAX];
+	size_t window = (size_t) spt_fault_around * PGSIZE;
+	uint8_t *start = (sequential
+					  ? spte->upage
+					  : (uint8_t *) ((uintptr_t) spte->upage / window * window));
+	uint8_t *end = start + window;
+	uint8_t *first, *last;
+	size_t cnt, i;
+	off_t length = 0;
+
+	if(!is_file_page (spte, NULL))
+		return false;
+
+	/* pseudOS: find the run of pages around SPTE. */
+	for (first = spte->upage; first > start; first -= PGSIZE)
+		if(!is_file_page (spt_find (first - PGSIZE), spt_find (first)))
+			break;
+	for (last = spte->upage; last + PGSIZE < end; last += PGSIZE)
+		if(!is_file_page (spt_find (last + PGSIZE), NULL)
+		   || !is_file_page (spt_find (last), spt_find (last + PGSIZE)))
+			break;
+	cnt = (last - first) / PGSIZE + 1;
+	if(cnt == 1)
+		return false;
+
+	for (i = 0; i < cnt; i++)
+	{
+		run[i] = spt_find (first + i * PGSIZE);
+		if(run[i] == spte)
+			kpages[i] = frame_table_insert (run[i]);
+		else if(run[i]->pinned != SPT_UNPINNED || frame_table_share (run[i]))
+			kpages[i] = NULL;			/* pseudOS: never take unevictable frames. */
+		else
+			kpages[i] = frame_table_try_insert (run[i]);
+		length = i * PGSIZE + run[i]->read_bytes;
+	}
+
+	lock_acquire (&around_lock);
+	lock_acquire (&syscall_lock);
+	off_t read_bytes = file_read_at (spte->file, around_buffer, length,
+									 spte->ofs - ((uint8_t *) spte->upage - first));
+	lock_release (&syscall_lock);
+
+	bool success = read_bytes == length;
+	for (i = 0; i < cnt; i++)
+	{
+		if(kpages[i] == NULL)
+			continue;
+		if(!success)
+		{
+			frame_table_remove (run[i]);
+			continue;
+		}
+		memcpy (kpages[i], around_buffer + i * PGSIZE, run[i]->read_bytes);
+		memset (kpages[i] + run[i]->read_bytes, 0, run[i]->zero_bytes);
+		pagedir_set_accessed (t->pagedir, run[i]->upage, run[i] == spte);
+		frame_table_unpin (kpages[i]);
+	}
+	lock_release (&around_lock);
+
+	if(success && sequential)
+	{
+		/* pseudOS: the page behind the scan is not needed again soon. */
+		uint8_t *behind = (uint8_t *) spte->upage - PGSIZE;
+		if(spt_lookup (t->spt, behind) != NULL)
+			pagedir_set_accessed (t->pagedir, behind, false);
+	}
+	return success && pagedir_get_page (t->pagedir, spte->upage) != NULL;
+}
+
+/*
+ * pseudOS: Makes SPTE resident in a frame of its own, reading it from swap or
+ * its file if needed.  Returns true if successful.
+ */
 bool
 spt_load_page (struct spt_entry_t *spte)
 {
@@ -142,10 +610,30 @@ spt_load_page (struct spt_entry_t *spte)
 	if(!is_pinned) 
 		spte->pinned = SPT_PINNED;
 
+	/* pseudOS: if the page is being evicted, it has to be written back before
+	   it can be loaded again. */
+	frame_table_wait_evicted (spte);
+
 	struct thread *t = thread_current ();
-	if(pagedir_get_page (t->pagedir, spte->upage))
+	void *kpage = pagedir_get_page (t->pagedir, spte->upage);
+	if(kpage != NULL && frame_table_is_zero (kpage))
+	{
+		/* pseudOS: copy-on-write from the zero page, which just means
+		   getting a zeroed frame of its own. */
+		frame_table_remove (spte);
+	}
+	else if(kpage != NULL && spte->writable && frame_table_is_shared (kpage))
+	{
+		/* pseudOS: copy-on-write after fork(). */
+		bool status = frame_table_copy_on_write (spte);
+		if (status)
+			pagedir_set_accessed (t->pagedir, spte->upage, true);
+		if(!is_pinned)
+			spte->pinned = SPT_UNPINNED;
+		return status;
+	}
+	else if(kpage != NULL)
 	{
-		spte->lru_ticks = timer_ticks ();
 		pagedir_set_accessed (t->pagedir, spte->upage, true);
 		if(!is_pinned)
 			spte->pinned = SPT_UNPINNED;
@@ -164,7 +652,6 @@ spt_load_page (struct spt_entry_t *spte)
 
 	if (status) 
 	{
-		spte->lru_ticks = timer_ticks ();
 		pagedir_set_accessed (t->pagedir, spte->upage, true);
 	}
 
@@ -176,38 +663,84 @@ spt_load_page (struct spt_entry_t *spte)
 static bool
 spt_load_page_swap (struct spt_entry_t *spte)
 {	
-	if(!frame_table_insert (spte))
+	void * kpage = frame_table_insert (spte);
+	if(!kpage)
 		return false;
 
-	swap_free (
-		spte->swap_page_index, 
-		pagedir_get_page (thread_current ()->pagedir, spte->upage));
+	int32_t idx = spte->swap_page_index;
+	swap_free (idx, kpage);
 	spte->swap_page_index = SWAP_INIT_IDX;
 
+	frame_table_unpin (kpage);
+	if(spt_advice (spte) != MADV_RANDOM)
+		spt_swap_readahead (idx);
 	return true;
 }
 
+/*
+ * pseudOS: Swaps in the pages of the current process in the swap_readahead
+ * slots after IDX, as long as there are free frames for them.  Swap slots are
+ * allocated in clusters, so these are likely pages that were swapped out
+ * together with the page in slot IDX, and they are read without seeking.
+ * Pages read ahead are not marked accessed, so they are evicted first if they
+ * are not used.
+ */
+static void
+spt_swap_readahead (int32_t idx)
+{
+	struct thread *t = thread_current ();
+	int i;
+
+	for (i = 1; i <= swap_readahead; i++)
+	{
+		void *upage = swap_slot_upage (idx + i, t);
+		if (upage == NULL)
+			break;
+
+		struct spt_entry_t *spte = spt_lookup (t->spt, upage);
+		if (spte == NULL)
+			break;
+		frame_table_wait_evicted (spte);
+		if (spte->swap_page_index != idx + i
+			|| pagedir_get_page (t->pagedir, upage) != NULL)
+			continue;
+
+		void *kpage = frame_table_try_insert (spte);
+		if (kpage == NULL)
+			break;
+		swap_free (spte->swap_page_index, kpage);
+		spte->swap_page_index = SWAP_INIT_IDX;
+		pagedir_set_dirty (t->pagedir, upage, true);
+		pagedir_set_accessed (t->pagedir, upage, false);
+		frame_table_unpin (kpage);
+	}
+}
+
 static bool
 spt_load_page_file (struct spt_entry_t *spte)
 {
+	if(frame_table_share (spte))
+		return true;
+
 	void * kpage = frame_table_insert (spte);
 	if(!kpage) return false;
 	
-	lock_acquire (&syscall_lock);
+	/* pseudOS: zero-fill pages need no file access, and are also loaded while
+	   syscall_lock is held, for the stack in load(). */
 	if(spte->read_bytes > 0)
 	{
+		lock_acquire (&syscall_lock);
 		off_t read_bytes = file_read_at (spte->file, kpage, spte->read_bytes, spte->ofs);
+		lock_release (&syscall_lock);
 		
 		if((off_t)spte->read_bytes != read_bytes)
 		{
-			palloc_free_page (kpage);
-			frame_table_remove (spte->upage);
-			lock_release (&syscall_lock);
+			frame_table_remove (spte);
 			return false;
 		} 
 		memset(kpage + spte->read_bytes, 0, spte->zero_bytes);
 	}
 
-	lock_release (&syscall_lock);
+	frame_table_unpin (kpage);
 	return true;
 }
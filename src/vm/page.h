@@ -8,6 +8,14 @@
 #include "filesys/off_t.h"
 
 #define SWAP_INIT_IDX -1
+
+/* pseudOS: Fault-around window, in pages. */
+#define SPT_FAULT_AROUND_DEFAULT 8
+#define SPT_FAULT_AROUND_MAX 32
+
+/* pseudOS: Most pages a process may lock with mlock(). */
+#define SPT_LOCKED_MAX 64
+
 #define SPT_PINNED true
 #define SPT_UNPINNED false
 
@@ -21,8 +29,6 @@ enum spt_entry_type_t
 struct spt_entry_t 
 {
 	struct hash_elem hashelem;
-	struct list_elem listelem;
-	int64_t lru_ticks;
 	struct file *file;
 	off_t ofs;
 	uint8_t *upage;
@@ -30,12 +36,18 @@ struct spt_entry_t
 	uint32_t zero_bytes;
 	bool writable;
 	bool pinned;
+	bool evicting;				/* pseudOS: Being written back by eviction. */
+	bool locked;				/* pseudOS: Locked into memory by mlock(). */
 	int32_t swap_page_index;
 	enum spt_entry_type_t type;
 };
 
 struct lock spt_lock;
 
+struct thread;
+
+extern int spt_fault_around;
+
 void spt_init(struct hash *spt);
 struct spt_entry_t * spt_insert (struct hash *spt, struct file *file, off_t ofs, 
 	uint8_t *upage, uint32_t read_bytes, uint32_t zero_bytes, bool writable, bool pinned,
@@ -44,8 +56,17 @@ struct spt_entry_t * spt_remove (struct hash *spt, void *upage);
 unsigned spt_entry_hash (const struct hash_elem *p_, void *aux UNUSED);
 bool spt_entry_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED);
 struct spt_entry_t * spt_lookup (struct hash *spt, const void *upage);
+struct spt_entry_t *spt_find (const void *vaddr);
 void spt_free (struct hash *spt);
 void spt_entry_free (struct hash_elem *e, void *aux);
 bool spt_load_page (struct spt_entry_t *spte);
+void spt_module_init (void);
+bool spt_fault (struct spt_entry_t *spte, bool write);
+bool spt_fork (struct thread *parent, struct file *executable);
+bool spt_madvise (void *addr, size_t len, int advice);
+bool spt_mlock (const void *addr, size_t len);
+bool spt_munlock (const void *addr, size_t len);
+bool spt_is_zero_fill (const struct spt_entry_t *spte);
+bool spt_is_shareable (const struct spt_entry_t *spte);
 
 #endif
\ No newline at end of file
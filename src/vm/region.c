@@ -0,0 +1,122 @@
+/*
+ * pseudOS: memory regions
+ */
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/syscall.h"
+#include "vm/region.h"
+
+#include <debug.h>
+
+/* pseudOS: Cache of regions. */
+static struct slab_cache region_cache;
+
+void
+region_init (void)
+{
+	slab_cache_init (&region_cache, "region", sizeof (struct region), NULL);
+}
+
+/*
+ * pseudOS: Adds a region of PAGE_CNT pages from START, whose first FILE_BYTES
+ * bytes are read from FILE at OFS, to REGIONS.  Returns the region, or NULL if
+ * it overlaps another one or memory runs out.
+ */
+struct region *
+region_add (struct list *regions, uint8_t *start, size_t page_cnt,
+			struct file *file, off_t ofs, off_t file_bytes, bool writable,
+			bool pinned, enum spt_entry_type_t type)
+{
+	struct list_elem *e;
+
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT ((size_t) file_bytes <= page_cnt * PGSIZE);
+
+	if(page_cnt == 0 || region_overlaps (regions, start, page_cnt))
+		return NULL;
+
+	struct region *r = slab_alloc (&region_cache);
+	if(r == NULL)
+		return NULL;
+	r->start = start;
+	r->page_cnt = page_cnt;
+	r->file = file;
+	r->ofs = ofs;
+	r->file_bytes = file_bytes;
+	r->writable = writable;
+	r->pinned = pinned;
+	r->type = type;
+	r->advice = MADV_NORMAL;
+
+	for (e = list_begin (regions); e != list_end (regions); e = list_next (e))
+		if(list_entry (e, struct region, elem)->start > start)
+			break;
+	list_insert (e, &r->elem);
+	return r;
+}
+
+/*
+ * pseudOS: Returns the region in REGIONS that contains VADDR, or NULL if there
+ * is none.
+ */
+struct region *
+region_find (struct list *regions, const void *vaddr)
+{
+	const uint8_t *addr = vaddr;
+	struct list_elem *e;
+
+	for (e = list_begin (regions); e != list_end (regions); e = list_next (e))
+	{
+		struct region *r = list_entry (e, struct region, elem);
+		if(addr < r->start)
+			break;
+		if(addr < r->start + r->page_cnt * PGSIZE)
+			return r;
+	}
+	return NULL;
+}
+
+/*
+ * pseudOS: Returns true if any of the PAGE_CNT pages from START is in a region
+ * in REGIONS.
+ */
+bool
+region_overlaps (struct list *regions, const void *start, size_t page_cnt)
+{
+	const uint8_t *begin = start;
+	const uint8_t *end = begin + page_cnt * PGSIZE;
+	struct list_elem *e;
+
+	for (e = list_begin (regions); e != list_end (regions); e = list_next (e))
+	{
+		struct region *r = list_entry (e, struct region, elem);
+		if(r->start >= end)
+			break;
+		if(r->start + r->page_cnt * PGSIZE > begin)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * pseudOS: Removes region R from its list and frees it.  The entries of its
+ * pages must have been removed already.
+ */
+void
+region_remove (struct region *r)
+{
+	list_remove (&r->elem);
+	slab_free (&region_cache, r);
+}
+
+/*
+ * pseudOS: Frees all regions in REGIONS.
+ */
+void
+region_free_all (struct list *regions)
+{
+	while(!list_empty (regions))
+		slab_free (&region_cache, 
+				   list_entry (list_pop_front (regions), struct region, elem));
+}
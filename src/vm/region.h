@@ -0,0 +1,39 @@
+#ifndef REGION_H
+#define REGION_H
+/*
+ * pseudOS: memory regions
+ */
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/page.h"
+
+/* pseudOS: A range of pages of a process's address space that is backed the
+   same way, an executable segment or a memory-mapped file.  Supplemental page
+   table entries for its pages are only created when they are first used, see
+   spt_find(). */
+struct region
+{
+	struct list_elem elem;		/* In the process's regions, sorted by START. */
+	uint8_t *start;				/* First page. */
+	size_t page_cnt;			/* Number of pages. */
+	struct file *file;			/* Backing file. */
+	off_t ofs;					/* Offset of the first page in FILE. */
+	off_t file_bytes;			/* Bytes read from FILE, the rest are zeros. */
+	bool writable;				/* Pages may be written. */
+	bool pinned;				/* Pages are created pinned. */
+	enum spt_entry_type_t type;	/* Type of the pages' entries. */
+	int advice;					/* MADV_* given with madvise(). */
+};
+
+void region_init (void);
+struct region *region_add (struct list *regions, uint8_t *start, size_t page_cnt,
+						   struct file *file, off_t ofs, off_t file_bytes,
+						   bool writable, bool pinned, enum spt_entry_type_t type);
+struct region *region_find (struct list *regions, const void *vaddr);
+bool region_overlaps (struct list *regions, const void *start, size_t page_cnt);
+void region_remove (struct region *r);
+void region_free_all (struct list *regions);
+
+#endif
@@ -1,6 +1,8 @@
 /*
  * pseudOS: swap table
  */
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
@@ -8,18 +10,48 @@
 #include "vm/page.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
+#include "vm/zswap.h"
 
 #include <bitmap.h>
 #include <list.h>
 #include <string.h>
 
+/* pseudOS: Indexes from ZSWAP_BASE on stand for pages in the compressed swap
+   cache instead of slots on disk. */
+#define ZSWAP_BASE ((int32_t) 1 << 30)
+#define is_compressed(IDX) ((IDX) >= ZSWAP_BASE)
+
+/* pseudOS: Slots are handed out in clusters of SWAP_CLUSTER consecutive slots,
+   so that pages swapped out one after another end up next to each other. */
+#define SWAP_CLUSTER 16
+
 static struct lock swap_lock;
 static struct block *swap_block;
 static struct bitmap *swap_bitmap;
 
 static int sectors_per_page;
 
-void 
+/* pseudOS: Current cluster, protected by swap_lock.  Slots CLUSTER_NEXT up to
+   CLUSTER_END are handed out next, as long as they are free. */
+static size_t cluster_next;
+static size_t cluster_end;
+
+/* pseudOS: Process and user virtual address of the page in each used slot,
+   protected by swap_lock. */
+static struct thread **slot_owners;
+static void **slot_upages;
+
+/* pseudOS: Bounce buffer for batched swap-outs, SWAP_BATCH pages. */
+static struct lock batch_lock;
+static uint8_t *batch_buffer;
+
+/* pseudOS: Pages swap-in reads ahead, set with the -swapra option. */
+int swap_readahead = SWAP_READAHEAD_DEFAULT;
+
+static size_t alloc_slots (size_t cnt);
+static void evict_to_disk (struct swap_page **pages, size_t cnt);
+
+void
 swap_init(void)
 {
 	sectors_per_page = PGSIZE / BLOCK_SECTOR_SIZE;
@@ -28,43 +60,240 @@ swap_init(void)
 	if(swap_block == NULL)
 		PANIC("No Swap space found!");
 
-	swap_bitmap = bitmap_create(block_size(swap_block) / sectors_per_page);
+	size_t slot_cnt = block_size(swap_block) / sectors_per_page;
+	swap_bitmap = bitmap_create(slot_cnt);
 	if(swap_bitmap == NULL)
 		PANIC("Cannot create swap bitmap!");
 
+	slot_owners = calloc(slot_cnt, sizeof *slot_owners);
+	slot_upages = calloc(slot_cnt, sizeof *slot_upages);
+	if((slot_owners == NULL || slot_upages == NULL) && slot_cnt > 0)
+		PANIC("Cannot create swap slot table!");
+
+	batch_buffer = palloc_get_multiple(PAL_ASSERT, SWAP_BATCH);
+
+	cluster_next = cluster_end = 0;
 	lock_init(&swap_lock);
+	lock_init(&batch_lock);
+	zswap_init ();
 }
 
-
+/*
+ * pseudOS: Allocates a swap slot for KPAGE, the page at UPAGE of OWNER, writes
+ * it there and returns the slot's index.
+ */
 int32_t
-swap_evict (void *kpage)
+swap_evict (void *kpage, struct thread *owner, void *upage)
+{
+	struct swap_page page;
+
+	page.kpage = kpage;
+	page.owner = owner;
+	page.upage = upage;
+	swap_evict_multiple (&page, 1);
+	return page.idx;
+}
+
+/*
+ * pseudOS: Swaps out the CNT pages in PAGES, at most SWAP_BATCH, and stores the
+ * index of each one's slot in its IDX member.  Pages are kept compressed in
+ * memory where possible.  The others go to disk, with a single request if there
+ * are enough consecutive free slots for all of them.
+ */
+void
+swap_evict_multiple (struct swap_page *pages, size_t cnt)
+{
+	struct swap_page *disk_pages[SWAP_BATCH];
+	size_t disk_cnt = 0, i;
+
+	ASSERT (cnt > 0 && cnt <= SWAP_BATCH);
+
+	for (i = 0; i < cnt; i++)
+	{
+		int32_t handle;
+		if (zswap_store (pages[i].kpage, &handle))
+			pages[i].idx = ZSWAP_BASE + handle;
+		else
+			disk_pages[disk_cnt++] = &pages[i];
+	}
+	if (disk_cnt > 0)
+		evict_to_disk (disk_pages, disk_cnt);
+}
+
+/*
+ * pseudOS: Writes the CNT pages in PAGES to consecutive slots on disk, if
+ * possible, or else one by one.
+ */
+static void
+evict_to_disk (struct swap_page **pages, size_t cnt)
 {
+	size_t i;
+
 	lock_acquire(&swap_lock);
-	size_t idx = bitmap_scan_and_flip(swap_bitmap, 0, 1, SWAP_FREE);
+	size_t idx = alloc_slots (cnt);
+	if(idx != BITMAP_ERROR)
+		for (i = 0; i < cnt; i++)
+		{
+			pages[i]->idx = idx + i;
+			slot_owners[idx + i] = pages[i]->owner;
+			slot_upages[idx + i] = pages[i]->upage;
+		}
+	lock_release(&swap_lock);
+
 	if(idx == BITMAP_ERROR)
-		PANIC("Swap space is full!");
+	{
+		/* pseudOS: no room for all of them together. */
+		if(cnt == 1)
+			PANIC("Swap space is full!");
+		for (i = 0; i < cnt; i++)
+			evict_to_disk (&pages[i], 1);
+		return;
+	}
 
-	void *buffer = kpage;
-	block_sector_t sector = idx * sectors_per_page;
-	for (; buffer < kpage + PGSIZE; buffer+=BLOCK_SECTOR_SIZE, sector++)
-		block_write (swap_block, sector, buffer);
+	/* pseudOS: the slots are ours, so other swap-ins and swap-outs can be
+	   queued at the disk at the same time as this write. */
+	if(cnt == 1)
+	{
+		block_write_multiple (swap_block, idx * sectors_per_page, pages[0]->kpage,
+							  sectors_per_page);
+		return;
+	}
 
-	lock_release(&swap_lock);
-	return (int32_t)idx;
+	lock_acquire(&batch_lock);
+	for (i = 0; i < cnt; i++)
+		memcpy (batch_buffer + i * PGSIZE, pages[i]->kpage, PGSIZE);
+	block_write_multiple (swap_block, idx * sectors_per_page, batch_buffer,
+						  cnt * sectors_per_page);
+	lock_release(&batch_lock);
 }
 
 void
 swap_free (int32_t idx, void *kpage)
 {
+	if(is_compressed (idx))
+	{
+		zswap_load (idx - ZSWAP_BASE, kpage);
+		return;
+	}
+
+	zswap_record_disk_load ();
+	if(bitmap_test (swap_bitmap, idx) != SWAP_USED)
+		PANIC("Invalid swap page index!");
+
+	/* pseudOS: read before freeing the slot, so that it cannot be reused
+	   and overwritten while the read is still queued. */
+	block_read_multiple (swap_block, idx * sectors_per_page, kpage, sectors_per_page);
+
+	swap_release (idx);
+}
+
+/*
+ * pseudOS: Reads the page in swap slot IDX into KPAGE, and keeps the slot.
+ */
+void
+swap_read (int32_t idx, void *kpage)
+{
+	if(is_compressed (idx))
+	{
+		zswap_read (idx - ZSWAP_BASE, kpage);
+		return;
+	}
+
+	if(bitmap_test (swap_bitmap, idx) != SWAP_USED)
+		PANIC("Invalid swap page index!");
+	block_read_multiple (swap_block, idx * sectors_per_page, kpage, sectors_per_page);
+}
+
+/*
+ * pseudOS: Stores KPAGE, the new contents of the page at UPAGE of OWNER that is
+ * in swap slot IDX, and returns the slot it is in now.  A slot on disk is
+ * overwritten in place, a compressed page is replaced.
+ */
+int32_t
+swap_rewrite (int32_t idx, void *kpage, struct thread *owner, void *upage)
+{
+	if(is_compressed (idx))
+	{
+		swap_release (idx);
+		return swap_evict (kpage, owner, upage);
+	}
+
+	if(bitmap_test (swap_bitmap, idx) != SWAP_USED)
+		PANIC("Invalid swap page index!");
+
+	block_write_multiple (swap_block, idx * sectors_per_page, kpage, sectors_per_page);
+	return idx;
+}
+
+/*
+ * pseudOS: Frees swap slot IDX without reading it, for a page that is freed.
+ */
+void
+swap_release (int32_t idx)
+{
+	if(is_compressed (idx))
+	{
+		zswap_free (idx - ZSWAP_BASE);
+		return;
+	}
+
 	lock_acquire(&swap_lock);
 	if(bitmap_test (swap_bitmap, idx) != SWAP_USED)
 		PANIC("Invalid swap page index!");
-	bitmap_flip(swap_bitmap, idx);
+	bitmap_reset(swap_bitmap, idx);
+	slot_owners[idx] = NULL;
+	slot_upages[idx] = NULL;
+	lock_release(&swap_lock);
+}
 
-	void *buffer = kpage;
-	block_sector_t sector = idx * sectors_per_page;
-	for (; buffer < kpage + PGSIZE; buffer+=BLOCK_SECTOR_SIZE, sector++)
-		block_read (swap_block, sector, buffer);
+/*
+ * pseudOS: Returns the user virtual address of the page in swap slot IDX if
+ * the slot is on disk and in use by a page of OWNER, and NULL otherwise.
+ */
+void *
+swap_slot_upage (int32_t idx, struct thread *owner)
+{
+	void *upage = NULL;
 
+	if(idx < 0 || (size_t) idx >= bitmap_size (swap_bitmap))
+		return NULL;
+
+	lock_acquire(&swap_lock);
+	if(bitmap_test (swap_bitmap, idx) == SWAP_USED && slot_owners[idx] == owner)
+		upage = slot_upages[idx];
 	lock_release(&swap_lock);
+	return upage;
+}
+
+/*
+ * pseudOS: Marks CNT consecutive free slots as used and returns the first one,
+ * or BITMAP_ERROR if there are none.  Takes them from the current cluster if it
+ * has room, otherwise starts a new cluster at the next run of SWAP_CLUSTER free
+ * slots.  Must be called with swap_lock held.
+ */
+static size_t
+alloc_slots (size_t cnt)
+{
+	size_t idx;
+
+	if(cluster_next + cnt > cluster_end
+	   || !bitmap_none (swap_bitmap, cluster_next, cnt))
+	{
+		size_t n = cnt > SWAP_CLUSTER ? cnt : SWAP_CLUSTER;
+		size_t start = bitmap_scan (swap_bitmap, cluster_end, n, SWAP_FREE);
+		if(start == BITMAP_ERROR)
+			start = bitmap_scan (swap_bitmap, 0, n, SWAP_FREE);
+		if(start == BITMAP_ERROR)
+		{
+			/* pseudOS: no free cluster left, take any free slots. */
+			return bitmap_scan_and_flip (swap_bitmap, 0, cnt, SWAP_FREE);
+		}
+		cluster_next = start;
+		cluster_end = start + n;
+	}
+
+	idx = cluster_next;
+	bitmap_set_multiple (swap_bitmap, idx, cnt, SWAP_USED);
+	cluster_next += cnt;
+	return idx;
 }
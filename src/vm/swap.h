@@ -9,9 +9,32 @@
 #define SWAP_FREE 0
 #define SWAP_USED 1
 
+/* pseudOS: Most pages swap_evict_multiple() writes at once. */
+#define SWAP_BATCH 8
+
+/* pseudOS: Default number of pages swap-in reads ahead. */
+#define SWAP_READAHEAD_DEFAULT 4
+
+extern int swap_readahead;
+
+struct thread;
+
+/* pseudOS: A page to swap out. */
+struct swap_page
+{
+	void *kpage;				/* Contents. */
+	struct thread *owner;		/* Process the page belongs to. */
+	void *upage;				/* User virtual address of the page. */
+	int32_t idx;				/* Slot, set by swap_evict_multiple(). */
+};
 
 void swap_init(void);
-int32_t swap_evict (void *kpage);
+int32_t swap_evict (void *kpage, struct thread *owner, void *upage);
+void swap_evict_multiple (struct swap_page *pages, size_t cnt);
 void swap_free (int32_t sector, void *kpage);
+void swap_read (int32_t idx, void *kpage);
+int32_t swap_rewrite (int32_t idx, void *kpage, struct thread *owner, void *upage);
+void swap_release (int32_t idx);
+void *swap_slot_upage (int32_t idx, struct thread *owner);
 
 #endif
\ No newline at end of file
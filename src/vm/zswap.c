@@ -0,0 +1,364 @@
+/*
+ * pseudOS: compressed swap cache
+ *
+ * Sits in front of the swap partition.  Pages that are swapped out are
+ * compressed into an arena of kernel memory, and only go to disk if they do not
+ * compress to at most ZSWAP_MAX_SIZE bytes or if the arena is full.
+ *
+ * The compressor is a small LZ77 in the style of LZ4.  The output is a series
+ * of sequences, each a token byte, literals, and a match:
+ *
+ *   token      high nibble: number of literals, low nibble: match length
+ *              minus MIN_MATCH.  15 means more length bytes follow, each
+ *              added to it, up to the first one that is not 255.
+ *   literals   copied to the output as they are.
+ *   offset     2 bytes, little-endian: how far back the match starts in the
+ *              output.  The match is copied from there, and may overlap the
+ *              bytes it produces.
+ *
+ * The last sequence has no match and ends the page.
+ */
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/zswap.h"
+
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ZSWAP_CHUNK 64					/* Arena allocation unit, in bytes. */
+#define ZSWAP_MAX_SIZE (PGSIZE / 2)		/* Largest compressed page stored. */
+#define ZSWAP_HEADER 2					/* Bytes of the length before a page. */
+
+#define MIN_MATCH 4						/* Shortest match. */
+#define HASH_BITS 12					/* Size of the match finder's table. */
+#define HASH_EMPTY 0xffff				/* Empty match finder table entry. */
+
+/* pseudOS: Size of the arena in pages, set with the -zswap option. */
+int zswap_arena_pages = ZSWAP_ARENA_DEFAULT;
+
+/* pseudOS: All members below are protected by zswap_lock. */
+static struct lock zswap_lock;
+static uint8_t *arena;					/* Compressed pages, NULL if disabled. */
+static struct bitmap *chunk_map;		/* Used chunks of the arena. */
+
+/* pseudOS: Working memory of the compressor. */
+static uint16_t hash_table[1 << HASH_BITS];
+static uint8_t scratch[ZSWAP_MAX_SIZE];
+
+/* pseudOS: Statistics. */
+static unsigned long long stored_cnt;		/* Pages stored. */
+static unsigned long long incompressible_cnt;	/* Pages that went to disk. */
+static unsigned long long full_cnt;			/* Pages the arena had no room for. */
+static unsigned long long hit_cnt;			/* Swap-ins from the arena. */
+static unsigned long long miss_cnt;			/* Swap-ins from disk. */
+static unsigned long long compressed_bytes;	/* Total size of stored pages. */
+
+static size_t compress (const uint8_t *src, uint8_t *dst, size_t cap);
+static bool decompress (const uint8_t *src, size_t len, uint8_t *dst);
+static size_t unpack (int32_t handle, void *kpage);
+
+void
+zswap_init (void)
+{
+	lock_init (&zswap_lock);
+	arena = NULL;
+	if (zswap_arena_pages <= 0)
+		return;
+
+	arena = palloc_get_multiple (0, zswap_arena_pages);
+	if (arena == NULL)
+	{
+		printf ("zswap: cannot allocate %d page arena, disabled\n", zswap_arena_pages);
+		return;
+	}
+	chunk_map = bitmap_create ((size_t) zswap_arena_pages * PGSIZE / ZSWAP_CHUNK);
+	if (chunk_map == NULL)
+		PANIC ("Cannot create zswap chunk map!");
+}
+
+/*
+ * pseudOS: Compresses KPAGE into the arena.  Returns true and stores a handle
+ * for it in *HANDLE if successful, false if the page does not compress well
+ * enough or the arena is full.
+ */
+bool
+zswap_store (const void *kpage, int32_t *handle)
+{
+	if (arena == NULL)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	size_t len = compress (kpage, scratch, sizeof scratch);
+	if (len == 0)
+	{
+		incompressible_cnt++;
+		lock_release (&zswap_lock);
+		return false;
+	}
+
+	size_t idx = bitmap_scan_and_flip (chunk_map, 0,
+									   DIV_ROUND_UP (ZSWAP_HEADER + len, ZSWAP_CHUNK), false);
+	if (idx == BITMAP_ERROR)
+	{
+		full_cnt++;
+		lock_release (&zswap_lock);
+		return false;
+	}
+
+	uint8_t *p = arena + idx * ZSWAP_CHUNK;
+	p[0] = len & 0xff;
+	p[1] = len >> 8;
+	memcpy (p + ZSWAP_HEADER, scratch, len);
+	stored_cnt++;
+	compressed_bytes += len;
+	lock_release (&zswap_lock);
+
+	*handle = idx;
+	return true;
+}
+
+/*
+ * pseudOS: Decompresses the page with HANDLE into KPAGE, and frees it.
+ */
+void
+zswap_load (int32_t handle, void *kpage)
+{
+	lock_acquire (&zswap_lock);
+	size_t len = unpack (handle, kpage);
+	bitmap_set_multiple (chunk_map, handle,
+						 DIV_ROUND_UP (ZSWAP_HEADER + len, ZSWAP_CHUNK), false);
+	hit_cnt++;
+	lock_release (&zswap_lock);
+}
+
+/*
+ * pseudOS: Decompresses the page with HANDLE into KPAGE, and keeps it.
+ */
+void
+zswap_read (int32_t handle, void *kpage)
+{
+	lock_acquire (&zswap_lock);
+	unpack (handle, kpage);
+	lock_release (&zswap_lock);
+}
+
+/*
+ * pseudOS: Frees the page with HANDLE without reading it.
+ */
+void
+zswap_free (int32_t handle)
+{
+	lock_acquire (&zswap_lock);
+	uint8_t *p = arena + handle * ZSWAP_CHUNK;
+	size_t len = p[0] | (p[1] << 8);
+	bitmap_set_multiple (chunk_map, handle,
+						 DIV_ROUND_UP (ZSWAP_HEADER + len, ZSWAP_CHUNK), false);
+	lock_release (&zswap_lock);
+}
+
+/*
+ * pseudOS: Records a swap-in that had to go to disk.
+ */
+void
+zswap_record_disk_load (void)
+{
+	lock_acquire (&zswap_lock);
+	miss_cnt++;
+	lock_release (&zswap_lock);
+}
+
+/*
+ * pseudOS: Prints statistics, if any page was swapped out.
+ */
+void
+zswap_print_stats (void)
+{
+	unsigned long long attempt_cnt = stored_cnt + incompressible_cnt + full_cnt;
+	if (attempt_cnt == 0)
+		return;
+
+	printf ("zswap: %llu pages stored, %llu incompressible, %llu arena full\n",
+			stored_cnt, incompressible_cnt, full_cnt);
+	if (hit_cnt + miss_cnt > 0)
+		printf ("zswap: %llu hits, %llu misses, %llu%% hit rate\n",
+				hit_cnt, miss_cnt, hit_cnt * 100 / (hit_cnt + miss_cnt));
+	if (compressed_bytes > 0)
+	{
+		unsigned long long ratio = stored_cnt * PGSIZE * 100 / compressed_bytes;
+		printf ("zswap: %llu.%02llu compression ratio, %llu bytes saved\n",
+				ratio / 100, ratio % 100, stored_cnt * PGSIZE - compressed_bytes);
+	}
+}
+
+/* pseudOS: Decompresses the page with HANDLE into KPAGE and returns its
+   compressed size.  Must be called with zswap_lock held. */
+static size_t
+unpack (int32_t handle, void *kpage)
+{
+	uint8_t *p = arena + handle * ZSWAP_CHUNK;
+	size_t len = p[0] | (p[1] << 8);
+	if (!decompress (p + ZSWAP_HEADER, len, kpage))
+		PANIC ("Corrupt compressed page (handle=%d)!", handle);
+	return len;
+}
+
+/* pseudOS: Returns the 4 bytes at P. */
+static uint32_t
+read32 (const uint8_t *p)
+{
+	uint32_t x;
+	memcpy (&x, p, sizeof x);
+	return x;
+}
+
+/* pseudOS: Returns the match finder's table index for the 4 bytes SEQ. */
+static size_t
+hash (uint32_t seq)
+{
+	return (seq * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* pseudOS: Returns the number of extra length bytes for length field X. */
+static size_t
+length_bytes (size_t x)
+{
+	return x >= 15 ? (x - 15) / 255 + 1 : 0;
+}
+
+/* pseudOS: Writes the extra length bytes for length field X, which must be at
+   least 15, at DST + *OP. */
+static void
+write_length (uint8_t *dst, size_t *op, size_t x)
+{
+	for (x -= 15; x >= 255; x -= 255)
+		dst[(*op)++] = 255;
+	dst[(*op)++] = x;
+}
+
+/*
+ * pseudOS: Appends a sequence of the LIT_CNT literals at LIT and a match of
+ * MATCH_LEN bytes at OFFSET, or no match if MATCH_LEN is 0, to DST, which
+ * holds OP bytes and has room for CAP.  Returns the new number of bytes in DST,
+ * or 0 if they do not fit.
+ */
+static size_t
+emit (uint8_t *dst, size_t op, size_t cap, const uint8_t *lit, size_t lit_cnt,
+	  size_t offset, size_t match_len)
+{
+	size_t m = match_len > 0 ? match_len - MIN_MATCH : 0;
+	size_t need = 1 + length_bytes (lit_cnt) + lit_cnt;
+	if (match_len > 0)
+		need += 2 + length_bytes (m);
+	if (op + need > cap)
+		return 0;
+
+	dst[op++] = ((lit_cnt < 15 ? lit_cnt : 15) << 4) | (m < 15 ? m : 15);
+	if (lit_cnt >= 15)
+		write_length (dst, &op, lit_cnt);
+	memcpy (dst + op, lit, lit_cnt);
+	op += lit_cnt;
+	if (match_len > 0)
+	{
+		dst[op++] = offset & 0xff;
+		dst[op++] = offset >> 8;
+		if (m >= 15)
+			write_length (dst, &op, m);
+	}
+	return op;
+}
+
+/*
+ * pseudOS: Compresses the page at SRC into DST, which has room for CAP bytes.
+ * Returns the compressed size, or 0 if it would be more than CAP.
+ */
+static size_t
+compress (const uint8_t *src, uint8_t *dst, size_t cap)
+{
+	size_t ip = 0, anchor = 0, op = 0;
+
+	memset (hash_table, 0xff, sizeof hash_table);
+	while (ip + MIN_MATCH <= PGSIZE)
+	{
+		uint32_t seq = read32 (src + ip);
+		size_t h = hash (seq);
+		size_t ref = hash_table[h];
+		hash_table[h] = ip;
+		if (ref == HASH_EMPTY || read32 (src + ref) != seq)
+		{
+			ip++;
+			continue;
+		}
+
+		size_t len = MIN_MATCH;
+		while (ip + len < PGSIZE && src[ref + len] == src[ip + len])
+			len++;
+		op = emit (dst, op, cap, src + anchor, ip - anchor, ip - ref, len);
+		if (op == 0)
+			return 0;
+		ip += len;
+		anchor = ip;
+	}
+	return emit (dst, op, cap, src + anchor, PGSIZE - anchor, 0, 0);
+}
+
+/* pseudOS: Adds the extra length bytes at SRC + *IP, of the LEN bytes at SRC,
+   to *X.  Returns false if they run past the end. */
+static bool
+read_length (const uint8_t *src, size_t len, size_t *ip, size_t *x)
+{
+	uint8_t b;
+	do
+	{
+		if (*ip >= len)
+			return false;
+		b = src[(*ip)++];
+		*x += b;
+	}
+	while (b == 255);
+	return true;
+}
+
+/*
+ * pseudOS: Decompresses the LEN bytes at SRC into the page at DST.  Returns
+ * false if they are not a valid compressed page.
+ */
+static bool
+decompress (const uint8_t *src, size_t len, uint8_t *dst)
+{
+	size_t ip = 0, op = 0;
+
+	for (;;)
+	{
+		if (ip >= len)
+			return false;
+		uint8_t token = src[ip++];
+
+		size_t lit_cnt = token >> 4;
+		if (lit_cnt == 15 && !read_length (src, len, &ip, &lit_cnt))
+			return false;
+		if (ip + lit_cnt > len || op + lit_cnt > PGSIZE)
+			return false;
+		memcpy (dst + op, src + ip, lit_cnt);
+		ip += lit_cnt;
+		op += lit_cnt;
+		if (op == PGSIZE)
+			return ip == len;
+
+		if (ip + 2 > len)
+			return false;
+		size_t offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		size_t match_len = token & 15;
+		if (match_len == 15 && !read_length (src, len, &ip, &match_len))
+			return false;
+		match_len += MIN_MATCH;
+		if (offset == 0 || offset > op || op + match_len > PGSIZE)
+			return false;
+		for (; match_len > 0; match_len--, op++)
+			dst[op] = dst[op - offset];
+	}
+}
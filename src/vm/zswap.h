@@ -0,0 +1,22 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+/*
+ * pseudOS: compressed swap cache
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* pseudOS: Default size of the compressed page arena, in pages. */
+#define ZSWAP_ARENA_DEFAULT 32
+
+extern int zswap_arena_pages;
+
+void zswap_init (void);
+bool zswap_store (const void *kpage, int32_t *handle);
+void zswap_load (int32_t handle, void *kpage);
+void zswap_read (int32_t handle, void *kpage);
+void zswap_free (int32_t handle);
+void zswap_record_disk_load (void);
+void zswap_print_stats (void);
+
+#endif